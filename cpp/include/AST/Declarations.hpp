@@ -110,6 +110,13 @@ public:
 
     bool static_mod = false;
     bool extern_mod = false;
+
+    // Layout attributes of a field: at least this aligned (0 for its type's alignment), not aligned at all when packed
+    int align = 0;
+    bool packed = false;
+
+    // Of a field in its struct, in bytes, set by Layout: -1 when unknown, for static and extern fields and other variables
+    int offset = -1;
 };
 
 // TODO: template redefinition checked while building symtable
@@ -164,6 +171,27 @@ public:
             buff += '>';
         }
 
+        std::string attributes;
+        if (reorder) {
+            attributes += ", reorder";
+        }
+
+        if (packed) {
+            attributes += ", packed";
+        }
+
+        if (soa) {
+            attributes += ", soa";
+        }
+
+        if (align) {
+            attributes += ", align(" + std::to_string(align) + ')';
+        }
+
+        if (!attributes.empty()) {
+            buff += " [" + attributes.substr(2) + ']';
+        }
+
         return buff;
     }
 
@@ -175,6 +203,15 @@ public:
     std::vector<std::unique_ptr<VariableDeclaration>> fields;
     std::vector<std::unique_ptr<TypeDeclaration>> subdecls;
     std::vector<TemplateDeclaration> templates;
+
+    // Layout attributes, see Layout: its fields are laid out by decreasing alignment rather than in order,
+    // it is at least this aligned (0 for its fields' alignment), its fields are not aligned when packed
+    bool reorder = false;
+    int align = 0;
+    bool packed = false;
+
+    // Its arrays are stored a field after the other, each in a contiguous column, see Layout::lower
+    bool soa = false;
 };
 
 class AliasDeclaration : public TypeDeclaration {
@@ -319,6 +356,63 @@ public:
     std::unique_ptr<Type> return_type;
     std::unique_ptr<Scope> body;
     std::vector<TemplateDeclaration> templates;
+
+    // Unparsed body tokens, from the opening to the closing curly brace, when the body was skipped (see Options::lazy_bodies).
+    // Parser::body parses them on demand, the token stream must still be alive by then.
+    Token *body_start = nullptr;
+    Token *body_end = nullptr;
+    Unit *body_unit = nullptr;
+    uint32_t body_owner = 0;
+
+    // Set when they failed to parse, it was reported then and they are not parsed again
+    bool body_failed = false;
+
+    bool body_pending() const {
+        return !body && body_start && !body_failed;
+    }
 };
 
+// Stands for a declaration or statement that failed to parse in recover mode (see Options::recover_errors),
+// the token spans what was skipped.
+class SyntaxError : public Declaration {
+public:
+    SyntaxError (Token _token, std::string _message) : Declaration(_token, nullptr, Kind::SyntaxError), message(_message) {}
+
+    std::string debugString() {
+        return "SYNTAXERROR[message=" + message + ']';
+    }
+
+    std::string displayString() {
+        return "<syntax error>";
+    }
+
+    void accept(Walker& w) {
+        w.walk(this);
+    }
+
+    std::string message;
+};
+
+// Empty for declarations without a name (syntax errors)
+inline std::string declaration_name(Declaration *decl) {
+    switch (decl->kind) {
+        case Node::Kind::NamespaceDecl:
+            return static_cast<NamespaceDeclaration*>(decl)->name;
+        case Node::Kind::FuncDecl:
+            return static_cast<FunctionDeclaration*>(decl)->name;
+        case Node::Kind::TemplateDecl:
+            return static_cast<TemplateDeclaration*>(decl)->name;
+        case Node::Kind::StructDecl:
+            return static_cast<StructDeclaration*>(decl)->name;
+        case Node::Kind::VariableDecl:
+            return static_cast<VariableDeclaration*>(decl)->name;
+        case Node::Kind::AliasDecl:
+            return static_cast<AliasDeclaration*>(decl)->name;
+        case Node::Kind::VariantDecl:
+            return static_cast<VariantDeclaration*>(decl)->name;
+        default:
+            return "";
+    }
+}
+
 #endif
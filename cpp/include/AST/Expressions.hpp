@@ -323,6 +323,9 @@ public:
 
     std::unique_ptr<Expression> expr;
     std::unique_ptr<Type> arg_type;
+
+    // Folded by Layout, -1 when the size is not known at compile time
+    int64_t value = -1;
 };
 
 class UnaryOperator : public Expression {
@@ -627,11 +630,16 @@ public:
 
     std::unique_ptr<Expression> expr;
     std::string field_name;
+
+    // Set by Layout when expr is an element of an array of a [soa] struct, arr[i].field: the field is at
+    // base + length * column + i * stride, base and length being those of the array. -1 otherwise
+    int column = -1;
+    int stride = -1;
 };
 
 class IsExpr : public Expression {
 public:
-    IsExpr (Token _token, Expression *_base, std::string _tag, std::vector<std::unique_ptr<Expression>> _exprs) : Expression(_token, nullptr, Kind::IfExpr, nullptr),
+    IsExpr (Token _token, Expression *_base, std::string _tag, std::vector<std::unique_ptr<Expression>> _exprs) : Expression(_token, nullptr, Kind::IsExpr, nullptr),
                                                                                                                   base(_base), tag(_tag), exprs(std::move(_exprs)) {}
 
     std::string debugString() {
@@ -4,16 +4,37 @@
 #include "Node.hpp"
 #include "Walker.hpp"
 
+#include <vector>
+
 class Import : public Node {
 public:
-    Import (Token _token, const std::string& path) : Node(_token, nullptr, Node::Kind::Import), unit_path(path) {}
+    Import (Token _token, const std::string& path, std::vector<std::string> _names) : Node(_token, nullptr, Node::Kind::Import), unit_path(path),
+                                                                                       names(std::move(_names)) {}
 
     std::string debugString() {
-        return "IMPORT[unit_path=" + unit_path +']';
+        return "IMPORT[unit_path=" + unit_path + selection() + ']';
     }
 
     std::string displayString() {
-        return "import " + unit_path;
+        return "import " + unit_path + selection();
+    }
+
+    // "/[a, b]" for a selective import, empty otherwise
+    std::string selection() const {
+        if (names.empty()) {
+            return "";
+        }
+
+        std::string buff = "/[";
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (i > 0) {
+                buff += ", ";
+            }
+
+            buff += names[i];
+        }
+
+        return buff + ']';
     }
 
     void accept(Walker& w) {
@@ -21,6 +42,9 @@ public:
     }
 
     std::string unit_path;
+
+    // Declarations listed by `import path/[a, b]`, the whole unit is imported when empty
+    std::vector<std::string> names;
 };
 
 #endif
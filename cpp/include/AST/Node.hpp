@@ -14,6 +14,7 @@ public:
         Unit, Use, Import, NamespaceDecl, FuncDecl,
         TemplateDecl,
         StructDecl, VariableDecl, AliasDecl, VariantDecl,
+        SyntaxError,
         BaseType, ArrayType, PointerType, ClosureType, FuncType, TupleType,
         Scope, IfStmt, WhileStmt, ForStmt, ReturnStmt, UsingStmt,
         BreakStmt, ContinueStmt,
@@ -46,6 +47,9 @@ public:
     virtual void accept(class Walker& w) = 0;
 };
 
+// Number of node kinds, keep in sync with the last entry of Node::Kind
+const size_t node_kind_count = static_cast<size_t>(Node::Kind::Ass) + 1;
+
 class Statement : public Node {
 public:
     Statement (Token _token, Node *_parent, Kind _kind) : Node(_token, _parent, _kind) {}
@@ -58,9 +62,11 @@ public:
 
 class TypeDeclaration : public Declaration {
 public:
-    TypeDeclaration (Token _token, Node *_parent, Kind _kind) : Declaration(_token, _parent, _kind), size(-1) {}
+    TypeDeclaration (Token _token, Node *_parent, Kind _kind) : Declaration(_token, _parent, _kind), size(-1), alignment(-1) {}
 
+    // In bytes, set by Layout, -1 when unknown (templates, what does not resolve)
     int size;
+    int alignment;
 };
 
 class Type : public Node {
@@ -70,7 +76,10 @@ public:
     Type (Token _token, Node *_parent, Kind _kind) : Node(_token, _parent, _kind), ref(nullptr) {}
 
     virtual bool isVoid() = 0;
+
+    // In bytes, -1 when unknown without laying out declarations and templates (see Layout)
     virtual int size() = 0;
+    virtual int alignment() = 0;
 };
 
 class Expression : public Statement {
@@ -82,6 +91,13 @@ public:
 
 // Some convenience functions
 bool void_type(Type *type);
+
+// Size and alignment of a builtin type, false for other names
+bool builtin_layout(const std::string& name, int& size, int& alignment);
+
+// offset rounded up to a multiple of alignment
+int align_up(int offset, int alignment);
+
 std::string unescape_string(std::string input);
 
 void toupper(std::string& in);
@@ -1,6 +1,7 @@
 #ifndef TYPES__HPP
 #define TYPES__HPP
 
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <string>
@@ -16,8 +17,33 @@ public:
         return types.empty();
     }
 
+    // Laid out like a struct with a field per type
     int size() {
-        return -1;
+        int offset = 0;
+
+        for (auto& type: types) {
+            if (type->size() < 0 || type->alignment() < 0) {
+                return -1;
+            }
+
+            offset = align_up(offset, type->alignment()) + type->size();
+        }
+
+        return align_up(offset, alignment());
+    }
+
+    int alignment() {
+        int most = 1;
+
+        for (auto& type: types) {
+            if (type->alignment() < 0) {
+                return -1;
+            }
+
+            most = std::max(most, type->alignment());
+        }
+
+        return most;
     }
 
     std::string debugString() {
@@ -76,6 +102,10 @@ public:
         return 16;
     }
 
+    int alignment() {
+        return 8;
+    }
+
     std::string debugString() {
         std::string buff = "CLOSURETYPE[argTypes=(";
         if (!argTypes.empty()) {
@@ -148,6 +178,10 @@ public:
         return 8;
     }
 
+    int alignment() {
+        return 8;
+    }
+
     std::string debugString() {
         std::string buff = "FUNCTYPE[argTypes=(";
         if (!argTypes.empty()) {
@@ -212,6 +246,10 @@ public:
         return 8;
     }
 
+    int alignment() {
+        return 8;
+    }
+
     std::string debugString() {
         return "PointerType[inner=" + inner->debugString() +']';
     }
@@ -242,6 +280,10 @@ public:
         return 16;
     }
 
+    int alignment() {
+        return 8;
+    }
+
     std::string debugString() {
         return "ArrayType[inner=" + inner->debugString() +']';
     }
@@ -266,11 +308,23 @@ public:
     }
 
     int size() {
+        int size, alignment;
+
         if (ref) {
             return ref->size;
         }
 
-        return -1;
+        return builtin_layout(name, size, alignment) ? size : -1;
+    }
+
+    int alignment() {
+        int size, alignment;
+
+        if (ref) {
+            return ref->alignment;
+        }
+
+        return builtin_layout(name, size, alignment) ? alignment : -1;
     }
 
     std::string debugString() {
@@ -7,6 +7,10 @@
 
 #include <vector>
 #include <memory>
+#include <iterator>
+#include <cstdint>
+
+class CompilationContext;
 
 class Unit : public Node {
 public:
@@ -43,6 +47,106 @@ public:
         return true;
     }
 
+    // Records a node of this unit in the per-kind index.
+    // The parser calls this for every node it allocates, so passes that only care about a few kinds
+    // can iterate them directly instead of walking the whole tree.
+    // owner is the top-level declaration being parsed (see DeclSpan), 0 for uses and imports.
+    void index(Node *node, uint32_t owner) {
+        kind_index[static_cast<size_t>(node->kind)].push_back(node);
+        kind_owner[static_cast<size_t>(node->kind)].push_back(owner);
+    }
+
+    const std::vector<Node*>& nodes(Node::Kind kind) const {
+        return kind_index[static_cast<size_t>(kind)];
+    }
+
+    const std::vector<uint32_t>& owners(Node::Kind kind) const {
+        return kind_owner[static_cast<size_t>(kind)];
+    }
+
+    // Sizes of the kind lists, forget() drops what was indexed since.
+    // For parses that fail after the unit was built, their nodes may already be gone.
+    std::vector<size_t> index_mark() const {
+        std::vector<size_t> mark(node_kind_count);
+        for (size_t i = 0; i < node_kind_count; ++i) {
+            mark[i] = kind_index[i].size();
+        }
+
+        return mark;
+    }
+
+    void forget(const std::vector<size_t>& mark) {
+        for (size_t i = 0; i < node_kind_count; ++i) {
+            kind_index[i].resize(mark[i]);
+            kind_owner[i].resize(mark[i]);
+        }
+    }
+
+    uint32_t new_owner() {
+        return next_owner++;
+    }
+
+    // Moves the declarations and indexed nodes of a piece of this unit that was parsed separately in ours,
+    // the declarations are inserted before decls[at].
+    // Returns what was added to the piece's owners to keep them unique.
+    uint32_t splice(Unit& piece, size_t at) {
+        uint32_t offset = next_owner - 1;
+        next_owner += piece.next_owner - 1;
+
+        for (auto& decl: piece.decls) {
+            decl->parent = this;
+        }
+
+        for (auto& span: piece.spans) {
+            span.owner += offset;
+        }
+
+        decls.insert(decls.begin() + at, std::make_move_iterator(piece.decls.begin()), std::make_move_iterator(piece.decls.end()));
+        spans.insert(spans.begin() + at, piece.spans.begin(), piece.spans.end());
+        piece.decls.clear();
+        piece.spans.clear();
+
+        for (size_t i = 0; i < node_kind_count; ++i) {
+            kind_index[i].insert(kind_index[i].end(), piece.kind_index[i].begin(), piece.kind_index[i].end());
+
+            for (uint32_t owner: piece.kind_owner[i]) {
+                kind_owner[i].push_back(owner ? owner + offset : 0);
+            }
+
+            piece.kind_index[i].clear();
+            piece.kind_owner[i].clear();
+        }
+
+        return offset;
+    }
+
+    // Destroys decls[first] to decls[last - 1] and forgets the indexed nodes that no remaining declaration owns
+    void drop(size_t first, size_t last) {
+        decls.erase(decls.begin() + first, decls.begin() + last);
+        spans.erase(spans.begin() + first, spans.begin() + last);
+
+        std::vector<bool> live(next_owner, false);
+        live[0] = true;
+        for (auto& span: spans) {
+            live[span.owner] = true;
+        }
+
+        for (size_t i = 0; i < node_kind_count; ++i) {
+            size_t kept = 0;
+
+            for (size_t j = 0; j < kind_index[i].size(); ++j) {
+                if (live[kind_owner[i][j]]) {
+                    kind_index[i][kept] = kind_index[i][j];
+                    kind_owner[i][kept] = kind_owner[i][j];
+                    kept++;
+                }
+            }
+
+            kind_index[i].resize(kept);
+            kind_owner[i].resize(kept);
+        }
+    }
+
     void accept(Walker& w) {
         w.walk(this);
     }
@@ -55,14 +159,40 @@ public:
         return unit_path;
     }
 
+    // Length of contents, tokens being what it was lexed into: the END token sits on the terminating NUL
+    size_t contents_length(const std::vector<Token>& tokens) const {
+        return tokens.back().start - contents;
+    }
+
     std::string unit_path;
 
     char *contents;
 
+    // The context the unit was parsed in, lazily skipped bodies are parsed in it too
+    CompilationContext *context = nullptr;
+
     std::vector<std::unique_ptr<Use>> uses;
     std::vector<std::unique_ptr<Import>> imports;
 
     std::vector<std::unique_ptr<Declaration>> decls;
+
+    // Tokens of a top-level declaration, as indices in the unit's token stream, and the owner of its nodes.
+    // Parser::reparse uses them to find the declarations an edit touches.
+    struct DeclSpan {
+        size_t begin;
+        size_t end;
+        uint32_t owner;
+    };
+
+    // One per declaration in decls
+    std::vector<DeclSpan> spans;
+
+private:
+    // Non owning, in creation order
+    std::vector<Node*> kind_index[node_kind_count];
+    std::vector<uint32_t> kind_owner[node_kind_count];
+
+    uint32_t next_owner = 1;
 };
 
 #endif
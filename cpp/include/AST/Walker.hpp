@@ -12,6 +12,7 @@ class FunctionDeclaration;
 class StructDeclaration;
 class AliasDeclaration;
 class VariantDeclaration;
+class SyntaxError;
 
 class BaseType;
 class PointerType;
@@ -67,6 +68,7 @@ public:
     virtual void walk(StructDeclaration *decl) = 0;
     virtual void walk(AliasDeclaration *decl) = 0;
     virtual void walk(VariantDeclaration *decl) = 0;
+    virtual void walk(SyntaxError *error) = 0;
 
     virtual void walk(BaseType *type) = 0;
     virtual void walk(PointerType *type) = 0;
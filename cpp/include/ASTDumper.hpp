@@ -3,14 +3,47 @@
 
 #include <AST/All.hpp>
 #include <AST/Walker.hpp>
+#include <BufferedWriter.hpp>
 
 #include <cstdio>
+#include <cstdint>
+#include <bitset>
+#include <memory>
+#include <utility>
 #include <initializer_list>
 
-// Dumps a unit AST into a .dot file
+struct DumpOptions {
+    enum class Format {
+        // Graphviz digraph
+        Dot,
+        // One JSON object per node, edge and record
+        JsonLines,
+        // "SKYA" + version byte, then tagged records with LEB128 integers and NUL terminated strings,
+        // in which a backslash is written \\ and a NUL \0
+        Binary
+    };
+
+    Format format = Format::Dot;
+
+    // Maximum depth of AST nodes below the root (or below each selected subtree root), -1 for no limit.
+    int max_depth = -1;
+
+    // When any bit is set, only subtrees rooted at nodes of these kinds are dumped.
+    std::bitset<node_kind_count> subtree_kinds;
+
+    // Sets the format by name (dot, jsonl or binary), the depth, and the kinds from a comma separated list of
+    // Node::Kind names. False on a name it does not know.
+    bool read(const std::string& format_name, int depth, const std::string& kinds);
+
+    // Extension of the files of the format
+    const char *extension() const;
+};
+
+// Dumps a unit AST into a .dot, .jsonl or binary file
 class ASTDumper : public Walker {
 public:
     ASTDumper (Node *root, std::string outpath);
+    ASTDumper (Node *root, std::string outpath, const DumpOptions& _options);
 
     void walk(Unit *u);
     void walk(Use *u);
@@ -23,6 +56,7 @@ public:
     void walk(StructDeclaration *decl);
     void walk(AliasDeclaration *decl);
     void walk(VariantDeclaration *decl);
+    void walk(SyntaxError *error);
 
     void walk(BaseType *type);
     void walk(PointerType *type);
@@ -66,16 +100,39 @@ public:
 
 private:
     FILE *file;
+    std::unique_ptr<BufferedWriter> out;
+    DumpOptions options;
+
     int nodeCounter;
     int parent_id;
-    std::string desc;
+    const char *desc;
+
+    // Filtering state, see visit()
+    int depth;
+    int depth_base;
+    bool inside;
+    int subtree_root;
+
+    void dump(Node *root);
+    void visit(Node *n);
+
+    bool emitting();
+
+    void child(const char *_desc);
+
+    void label(const char *text, size_t length);
+    void label(const char *text);
+    void label(const std::string& text);
+    void string_end();
 
-    void child(const std::string& _desc);
+    int begin_node();
+    void end_node();
 
-    void write(const std::string& str);
-    void writeln(const std::string& str);
+    int node(const char *text);
     int node(const std::string& text);
-    int record(std::initializer_list<std::string> values);
+    int node(const char *prefix, const std::string& text);
+    int node(int64_t value);
+    int record(std::initializer_list<std::pair<const char*, int64_t>> fields);
     int current();
     void edge(int a, int b);
 };
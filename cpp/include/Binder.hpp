@@ -0,0 +1,153 @@
+#ifndef BINDER__HPP
+#define BINDER__HPP
+
+#include <AST/All.hpp>
+#include <AST/Walker.hpp>
+#include <Exports.hpp>
+#include <Names.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Name binding: points every VariableAccess (VariableAccess::ref) and every BaseType (Type::ref) of a unit at the declaration
+// it names, nullptr when it names none (builtin types, fields, variant members).
+// Scopes nest as written: what the units it imports export (the last import first), the unit, namespaces, structs and variants (templates and nested types),
+// functions (templates and arguments), then blocks, where a declaration is seen from the statement after it on.
+// A qualified name a::b::c is looked up from its first segment outwards, then the rest in the members of what that names.
+//
+// Names are interned to ids in the Names of the compilation, scopes are flat open-addressing tables from id to declaration.
+// A binder keeps the ids it was given, asking for each name once.
+// The many small tables of blocks come from an arena freed with the binder. A binder binds one unit.
+// What is imported is not copied into tables: it is looked up in the frozen Exports of the imported units, by name.
+class Binder : public Walker {
+public:
+    // names must outlive the binder
+    Binder (Names& _names);
+    ~Binder ();
+
+    Binder(Binder const&) = delete;
+    void operator=(Binder const&) = delete;
+
+    // What another unit the unit imports exports, looked up after the declarations of the unit.
+    // exports must outlive the binder.
+    void import(const Exports *exports);
+
+    // Binds the references in unit, the lazily skipped bodies of its functions are parsed first
+    void bind(Unit *unit);
+
+    // Binds the types in decls, the top-level declarations of a unit, but not what is in function bodies and initializers:
+    // what laying types out needs (see Layout). decls may have been built from an interface.
+    void signatures(const std::vector<Declaration*>& decls);
+
+    void walk(Unit *u);
+    void walk(Use *u);
+    void walk(Import *i);
+
+    void walk(TemplateDeclaration *decl);
+    void walk(NamespaceDeclaration *decl);
+    void walk(VariableDeclaration *decl);
+    void walk(FunctionDeclaration *decl);
+    void walk(StructDeclaration *decl);
+    void walk(AliasDeclaration *decl);
+    void walk(VariantDeclaration *decl);
+    void walk(SyntaxError *error);
+
+    void walk(BaseType *type);
+    void walk(PointerType *type);
+    void walk(ArrayType *type);
+    void walk(FunctionType *type);
+    void walk(ClosureType *type);
+    void walk(TupleType *type);
+
+    void walk(Scope *scope);
+    void walk(IfStmt *ifStmt);
+    void walk(WhileStmt *whileStmt);
+    void walk(ForStmt *forStmt);
+    void walk(ReturnStmt *ret);
+    void walk(UsingStmt *usingStmt);
+    void walk(DeferStmt *defer);
+    void walk(MatchStmt *match);
+
+    void walk(BreakStmt *breakStmt);
+    void walk(ContinueStmt *contStmt);
+
+    void walk(VariableAccess *vAcc);
+    void walk(FieldAccess *fAcc);
+    void walk(BoolLiteral *lit);
+    void walk(StringLiteral *lit);
+    void walk(CharLiteral *lit);
+    void walk(IntLiteral *lit);
+    void walk(NullLiteral *lit);
+    void walk(FloatLiteral *lit);
+
+    void walk(ArrayIndexing *ai);
+    void walk(FunctionCall *call);
+    void walk(Sizeof *sof);
+
+    void walk(UnaryOperator *op);
+    void walk(Cast *cast);
+    void walk(IsExpr *is);
+    void walk(BinaryOperator *op);
+    void walk(Assignment *ass);
+
+    void walk(IfExpr *ifExpr);
+
+private:
+    struct Arena;
+    struct Table;
+    struct Using;
+    struct Name;
+
+    // A name the binder asked names for, its id is 0 while it has none
+    struct Known {
+        std::string text;
+        uint64_t hash;
+        uint32_t id;
+    };
+
+    uint32_t intern(const std::string& name);
+    uint32_t symbol(const std::string& name, uint64_t hash);
+    Known& known(const std::string& name, uint64_t hash);
+
+    Table *table(Table *parent, size_t expected);
+    void add(Table *table, Declaration *decl);
+    Declaration *get(Table *table, const Name& name, const Exports::Entry **frozen) const;
+    Table *members(Declaration *decl);
+
+    Declaration *lookup(const std::string& name, bool type, const Exports::Entry **frozen = nullptr);
+    Declaration *qualified(Table *table, const std::vector<std::string>& segments, size_t from, bool type, const Exports::Entry **frozen);
+    Declaration *qualified(const Exports *exports, const std::vector<std::string>& segments, size_t from, bool type, const Exports::Entry **frozen);
+
+    void visit(Node *node);
+    void statements(std::vector<std::unique_ptr<Statement>>& list);
+    void top(const std::vector<Declaration*>& decls);
+
+    std::unique_ptr<Arena> arena;
+
+    Names& names;
+
+    // Names asked for with their ids, and their index + 1 by hash of the name, open addressing too
+    std::vector<Known> known_names;
+    std::vector<uint32_t> known_slots;
+
+    std::vector<const Exports*> imported;
+
+    // Tables of the members of namespaces, structs and variants, made when first needed
+    std::unordered_map<Declaration*, Table*> member_tables;
+
+    // Namespaces declared again in the same scope, by the first one of their name, and the other way round
+    std::unordered_map<Declaration*, std::vector<Declaration*>> reopened;
+    std::unordered_map<Declaration*, Declaration*> first_of;
+
+    // Innermost scope of the walk
+    Table *current;
+
+    // Whether function bodies and initializers are walked
+    bool bodies;
+};
+
+#endif
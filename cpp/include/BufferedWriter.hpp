@@ -0,0 +1,61 @@
+#ifndef BUFFERED_WRITER__HPP
+#define BUFFERED_WRITER__HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Buffered output to a FILE, integers are formatted straight into the buffer.
+// Used by the dumpers, which write millions of tiny pieces.
+class BufferedWriter {
+public:
+    BufferedWriter (FILE *_file) : file(_file), used(0) {}
+
+    ~BufferedWriter () {
+        flush();
+    }
+
+    BufferedWriter(BufferedWriter const&) = delete;
+    void operator=(BufferedWriter const&) = delete;
+
+    inline void write(char c) {
+        if (used == capacity) {
+            flush();
+        }
+
+        buffer[used++] = c;
+    }
+
+    void write(const char *data, size_t length);
+
+    inline void write(const char *str) {
+        write(str, strlen(str));
+    }
+
+    inline void write(const std::string& str) {
+        write(str.data(), str.size());
+    }
+
+    // Decimal representation
+    void write_int(int64_t value);
+
+    // Unsigned LEB128, for binary output
+    void write_varint(uint64_t value);
+
+    // Zigzag encoded LEB128
+    inline void write_svarint(int64_t value) {
+        write_varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void flush();
+
+private:
+    static const size_t capacity = 64 * 1024;
+
+    FILE *file;
+    size_t used;
+    char buffer[capacity];
+};
+
+#endif
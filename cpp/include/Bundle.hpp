@@ -0,0 +1,60 @@
+#ifndef BUNDLE__HPP
+#define BUNDLE__HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Library bundle, lib.skyb in a library directory: the units of library lib (lib.sky, lib/path.sky) and the interfaces
+// that were up to date when it was written (lib/path.skyi), in one file mapped once per build.
+// `use lib/path` looks the unit up in its index instead of the file system.
+//
+// The file is an array of 32 bit words in host order, every reference in it is a byte offset from its start:
+//   header  "SKYB", version, byte order mark, entry count
+//   index   (name, name length, contents, contents length) per entry, sorted by name
+//   names   paths relative to the library directory
+//   data    the contents of the entries, each aligned to 8 bytes
+class Bundle {
+public:
+    // Not an entry
+    static const size_t none = static_cast<size_t>(-1);
+
+    // nullptr when path can't be read or is not a bundle of this version
+    static std::unique_ptr<Bundle> open(const std::string& path);
+
+    // Writes the files of entries, given as (name, file), false when one can't be read or path can't be written
+    static bool write(std::vector<std::pair<std::string, std::string>> entries, const std::string& path);
+
+    ~Bundle ();
+
+    Bundle(Bundle const&) = delete;
+    void operator=(Bundle const&) = delete;
+
+    size_t size() const {
+        return entries;
+    }
+
+    // Entry named name, none when there is none
+    size_t find(const std::string& name) const;
+
+    // Contents of entry i, in place
+    const char *data(size_t i) const;
+    size_t length(size_t i) const;
+
+private:
+    Bundle () {}
+
+    const uint32_t *words = nullptr;
+    size_t bytes = 0;
+    size_t entries = 0;
+
+    // What was mapped, or read when mapping is not available
+    void *mapping = nullptr;
+    size_t mapping_size = 0;
+    std::vector<uint64_t> copy;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CACHE__HPP
+#define CACHE__HPP
+
+#include <cstdint>
+#include <string>
+
+// Directory of what units compile to, named by a hash of what they were compiled from, so a unit compiled once
+// is not compiled again whatever the tree or the process. Any number of compilers may share it:
+// an entry is written aside under a name of the writer's own then renamed into place, readers see it whole or not at all,
+// and the same key always stands for the same bytes, whoever wrote them.
+// Entries are directory/ab/cdef0123456789.kind, ab being the first byte of the key.
+class Cache {
+public:
+    // Bumped whenever the compiler makes something else of the same unit, entries of other versions are not looked at
+    static const uint32_t version = 1;
+
+    Cache (const std::string& _directory) : directory(_directory) {}
+
+    Cache(Cache const&) = delete;
+    void operator=(Cache const&) = delete;
+
+    // Where the entry is, whether it exists or not
+    std::string path(uint64_t key, const std::string& kind) const;
+
+    bool has(uint64_t key, const std::string& kind) const;
+
+    // Copies file in as the entry, false when it can't
+    bool store(uint64_t key, const std::string& kind, const std::string& file);
+
+    // Copies the entry out to file, false when there is no such entry or file can't be written
+    bool fetch(uint64_t key, const std::string& kind, const std::string& file);
+
+    // Name in the directory no other thread nor process uses, for a file made to be stored
+    std::string scratch();
+
+private:
+    std::string directory;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef COMPILATION_CONTEXT__HPP
+#define COMPILATION_CONTEXT__HPP
+
+#include <Options.hpp>
+#include <Errors.hpp>
+#include <Diagnostics.hpp>
+#include <Names.hpp>
+
+#include <memory>
+
+// Settings, diagnostic sink and interned names of a compilation, handed explicitly to the parser (and kept by the units it makes).
+// A context is used by one thread at a time: a thread working for another one gets a fork(),
+// which has the same options and names and buffers its reports until the owner merge()s them.
+class CompilationContext {
+public:
+    // Reports go to a Diagnostics of the context's own
+    CompilationContext (const Options& _options) : options(_options), names(new Names()), own_diagnostics(new Diagnostics(options.max_errors)) {
+        diagnostics = own_diagnostics.get();
+        err_handler = diagnostics;
+    }
+
+    // Reports go to handler, diagnostics is nullptr
+    CompilationContext (const Options& _options, ErrorHandler *handler) : options(_options), err_handler(handler), diagnostics(nullptr), names(new Names()) {}
+
+    CompilationContext(CompilationContext const&) = delete;
+    void operator=(CompilationContext const&) = delete;
+
+    std::unique_ptr<CompilationContext> fork() {
+        auto sub = std::unique_ptr<CompilationContext>(new CompilationContext(options, nullptr));
+        sub->buffer.reset(new ErrorBuffer());
+        sub->err_handler = sub->buffer.get();
+        sub->names = names;
+        return sub;
+    }
+
+    // Reports of a fork with a token are made against unit, or the unit they were made against if it is nullptr.
+    // Merging is done on the owner's thread, in the order the reports should come out.
+    void merge(CompilationContext& sub, Unit *unit = nullptr) {
+        if (sub.buffer) {
+            sub.buffer->replay(err_handler, unit);
+            sub.buffer->clear();
+        }
+    }
+
+    // Reports of a fork not merged yet
+    size_t buffered() const {
+        return buffer ? buffer->size() : 0;
+    }
+
+    // Errors among them
+    size_t buffered_errors() const {
+        return buffer ? buffer->errors() : 0;
+    }
+
+    Options options;
+
+    ErrorHandler *err_handler;
+
+    // The handler to flush when the context has its own, the same as err_handler
+    Diagnostics *diagnostics;
+
+    // Shared with the forks, and with other contexts when they are given the same
+    std::shared_ptr<Names> names;
+
+private:
+    std::unique_ptr<Diagnostics> own_diagnostics;
+
+    // Reports of a fork
+    std::unique_ptr<ErrorBuffer> buffer;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef DIAGNOSTICS__HPP
+#define DIAGNOSTICS__HPP
+
+#include <Errors.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Error handler that only records reports: nothing is formatted nor thrown until flush(),
+// which sorts them by location, drops duplicates and renders the token views.
+// report() may be called from several threads at once, a record slot is claimed with a single fetch_add
+// in chunks allocated on demand. flush() and detach() must not run concurrently with report().
+// The units reported against must stay alive until flush(), or be detached before they go away.
+class Diagnostics : public ErrorHandler {
+public:
+    // Errors past max_errors are counted but not kept, and the handler is saturated. 0 keeps them all.
+    Diagnostics (size_t _max_errors = 0);
+    ~Diagnostics ();
+
+    Diagnostics(Diagnostics const&) = delete;
+    void operator=(Diagnostics const&) = delete;
+
+    void report(const std::string& message, ErrorLevel level = ErrorLevel::Error);
+    void report(Unit *unit, const Token& token, const std::string& message, ErrorLevel level = ErrorLevel::Error);
+    void report(Unit *unit, const Token& token, const char *message, ErrorLevel level = ErrorLevel::Error);
+
+    // Renders the records of unit now
+    void detach(Unit *unit);
+
+    bool saturated() {
+        return max_errors && error_count >= max_errors;
+    }
+
+    // Writes the records out and forgets them, the counts are kept
+    void flush(std::ostream& out);
+
+    size_t errors() const {
+        return error_count;
+    }
+
+    size_t warnings() const {
+        return warning_count;
+    }
+
+private:
+    struct Record {
+        ErrorLevel level;
+        Unit *unit;
+        Token token;
+
+        // A string literal, or nullptr when the message is in text
+        const char *message;
+        std::string text;
+
+        // Set by detach, unit is nullptr then
+        std::string rendered;
+        std::string path;
+
+        const char *str() const {
+            return message ? message : text.c_str();
+        }
+    };
+
+    Record *claim(ErrorLevel level);
+
+    static const size_t chunk_size = 256;
+    static const size_t max_chunks = 4096;
+
+    std::atomic<Record*> chunks[max_chunks];
+    std::atomic<size_t> used;
+
+    std::atomic<size_t> error_count;
+    std::atomic<size_t> warning_count;
+
+    // Reports that found no room, past max_errors or max_chunks
+    std::atomic<size_t> dropped;
+
+    size_t max_errors;
+};
+
+#endif
@@ -4,9 +4,11 @@
 #include <Lexer.hpp>
 #include <AST/Unit.hpp>
 
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
 #include <string>
+#include <vector>
 
 enum class ErrorLevel {
     Error,
@@ -15,10 +17,87 @@ enum class ErrorLevel {
 
 class ErrorHandler {
 public:
+    virtual ~ErrorHandler() {}
+
     virtual void report(const std::string& message, ErrorLevel level = ErrorLevel::Error) = 0;
     virtual void report(Unit *unit, const Token& token, const std::string& message, ErrorLevel level = ErrorLevel::Error) = 0;
+
+    // For messages that outlive the handler (string literals), handlers may keep the pointer instead of a copy
+    virtual void report(Unit *unit, const Token& token, const char *message, ErrorLevel level = ErrorLevel::Error) {
+        report(unit, token, std::string(message), level);
+    }
+
+    // The unit or its contents are about to go away, handlers must not look at them after this
+    virtual void detach(Unit *unit) {}
+
+    // Whether the handler wants no more reports, the parser gives up then
+    virtual bool saturated() {
+        return false;
+    }
 };
 
+// Renders a report with a clang-style token view
+inline std::string render_report(Unit *unit, const Token& token, const std::string& message, ErrorLevel level) {
+    std::string buff;
+
+    buff += "In unit " + unit->unit_path + ':' + std::to_string(token.line) + ':' + std::to_string(token.column) + ", ";
+
+    if (level == ErrorLevel::Error) {
+        buff += "error";
+    } else {
+        buff += "warning";
+    }
+
+    buff += ": \n" + message + '\n';
+
+    // Add a clang-style token view
+    char *contents = unit->contents;
+    char *start = token.start;
+
+    if (contents && start) {
+        std::string tokenview;
+        int offset = start - contents;
+
+        // This tries to find a portion of the string before the token's start to append
+        if (offset > 0) {
+            for (char *i = start - 1; ; --i) {
+                if (i < contents || *i == '\n' || ((*i == ' ' || *i == '\t') && start - i >= 10)) {
+                    tokenview += std::string(i + 1, start - i - 1);
+                    offset = start - i - 1;
+                    break;
+                }
+            }
+        }
+
+        // The END token sits on the terminating NUL
+        size_t length = strnlen(token.start, token.length);
+        tokenview += std::string(token.start, length);
+
+        // Same as above, but after the token
+        start = start + length;
+        char *i = start;
+        while (*i != '\0') {
+            if (*i == '\n' || ((*i == '\t' || *i == ' ') && i - start >= 10)) {
+                tokenview += std::string(start, i - start);
+                break;
+            }
+
+            ++i;
+        }
+
+        buff += '\n' + tokenview + '\n';
+
+        if (offset > 0) {
+            buff += std::string(offset, ' ');
+        }
+
+        buff += std::string(token.length, '~');
+        buff += '\n';
+    }
+
+    return buff;
+}
+
 class ErrorGobbler : public ErrorHandler {
 public:
     ErrorGobbler() {};
@@ -27,75 +106,87 @@ public:
     void report(Unit *unit, const Token& token, const std::string& message, ErrorLevel level = ErrorLevel::Error) {}
 };
 
-class DefaultErrorHandler : public ErrorHandler {
+// Keeps the reports to replay them later, in order, on another handler.
+// Used by parser threads so diagnostics come out in source order.
+class ErrorBuffer : public ErrorHandler {
 public:
-    DefaultErrorHandler() {};
+    ErrorBuffer() {};
 
     void report(const std::string& message, ErrorLevel level = ErrorLevel::Error) {
-        if (level == ErrorLevel::Error) {
-            throw std::runtime_error(message);
-        } else {
-            std::cout << message << std::endl;
-        }
+        reports.push_back({ nullptr, Token::empty, message, level });
     }
 
     void report(Unit *unit, const Token& token, const std::string& message, ErrorLevel level = ErrorLevel::Error) {
-        std::string buff;
+        reports.push_back({ unit, token, message, level });
+    }
 
-        buff += "In unit " + unit->unit_path + ':' + std::to_string(token.line) + ':' + std::to_string(token.column) + ", ";
+    // Reports with a token are replayed against unit, or the unit they were made against if it is nullptr
+    void replay(ErrorHandler *handler, Unit *unit = nullptr) {
+        for (auto& r: reports) {
+            if (r.unit) {
+                handler->report(unit ? unit : r.unit, r.token, r.message, r.level);
+            } else {
+                handler->report(r.message, r.level);
+            }
+        }
+    }
 
-        if (level == ErrorLevel::Error) {
-            buff += "error";
-        } else {
-            buff += "warning";
+    // Renders the reports made against unit now, it is going away
+    void detach(Unit *unit) {
+        for (auto& r: reports) {
+            if (r.unit == unit) {
+                r.message = render_report(unit, r.token, r.message, r.level);
+                r.unit = nullptr;
+            }
         }
+    }
 
-        buff += ": \n" + message + '\n';
+    void clear() {
+        reports.clear();
+    }
 
-        // Add a clang-style token view
-        char *contents = unit->contents;
-        char *start = token.start;
+    size_t size() const {
+        return reports.size();
+    }
 
-        if (contents && start) {
-            std::string tokenview;
-            int offset = start - contents;
+    size_t errors() const {
+        size_t count = 0;
 
-            // This tries to find a portion of the string before the token's start to append
-            if (offset > 0) {
-                for (char *i = start; i >= contents; --i) {
-                    if (*i == '\n' || ((*i == ' ' || *i == '\t') && start - i >= 10)) {
-                        tokenview += std::string(i + 1, start - i - 1);
-                        offset = start - i - 1;
-                        break;
-                    }
-                }
-            }
+        for (auto& r: reports) {
+            count += r.level == ErrorLevel::Error;
+        }
 
-            tokenview += std::string(token.start, token.length);
+        return count;
+    }
 
-            // Same as above, but after the token
-            start = start + token.length;
-            char *i = start;
-            while (*i != '\0') {
-                if (*i == '\n' || ((*i == '\t' || *i == ' ') && i - start >= 10)) {
-                    tokenview += std::string(start, i - start);
-                    break;
-                }
+private:
+    struct Report {
+        Unit *unit;
+        Token token;
+        std::string message;
+        ErrorLevel level;
+    };
 
-                ++i;
-            }
+    std::vector<Report> reports;
+};
 
-            buff += '\n' + tokenview + '\n';
+class DefaultErrorHandler : public ErrorHandler {
+public:
+    // Errors are only printed, like warnings, when not thrown
+    DefaultErrorHandler(bool _throw_errors = true) : throw_errors(_throw_errors) {};
 
-            if (offset > 0) {
-                buff += std::string(offset, ' ');
-            }
+    bool throw_errors;
 
-            buff += std::string(token.length, '~');
-            buff += '\n';
+    void report(const std::string& message, ErrorLevel level = ErrorLevel::Error) {
+        if (level == ErrorLevel::Error && throw_errors) {
+            throw std::runtime_error(message);
+        } else {
+            std::cout << message << std::endl;
         }
+    }
 
-        report(buff, level);
+    void report(Unit *unit, const Token& token, const std::string& message, ErrorLevel level = ErrorLevel::Error) {
+        report(render_report(unit, token, message, level), level);
     }
 };
 
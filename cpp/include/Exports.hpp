@@ -0,0 +1,65 @@
+#ifndef EXPORTS__HPP
+#define EXPORTS__HPP
+
+#include <AST/All.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// What a unit exports by name, frozen once it is analyzed: its visible top-level declarations and, the same way,
+// the members of each of its namespaces. The names are in a minimal perfect hash table (hash and displace): a lookup
+// reads the seed of the name's bucket then the one slot the seed sends it to, there are no collisions to probe.
+// Made once per build, the binders of every importer share it.
+class Exports {
+public:
+    struct Entry {
+        std::string name;
+        uint64_t hash;
+        Declaration *decl;
+
+        // Of a namespace: its members, with those of the namespaces declared again with its name
+        std::unique_ptr<Exports> members;
+    };
+
+    // Hash of a name
+    typedef uint64_t (*Hash)(const std::string& name);
+
+    // Interface::hash of name, what the tables of units are made with
+    static uint64_t name_hash(const std::string& name);
+
+    // A later declaration of a name hides an earlier one, but a namespace declared again adds to the first.
+    // The members of namespaces are hashed the same way.
+    explicit Exports (const std::vector<Declaration*>& decls, Hash hash = name_hash);
+
+    Exports(Exports const&) = delete;
+    void operator=(Exports const&) = delete;
+
+    // hash is the hash of name the table was made with, nullptr when nothing is named name
+    const Entry *find(const std::string& name, uint64_t hash) const;
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    // Minimal perfect hash of keys given by their hashes: a seed per bucket, and the key in each of the keys.size() slots.
+    // False when two keys have the same hash.
+    static bool perfect(const std::vector<uint64_t>& hashes, std::vector<uint32_t>& seeds, std::vector<uint32_t>& keys);
+
+    static size_t bucket(uint64_t hash, size_t buckets);
+    static size_t slot(uint64_t hash, uint32_t seed, size_t slots);
+
+private:
+    // Marks the seed of a bucket that is the slot of its one key
+    static const uint32_t direct = 0x80000000u;
+
+    // By slot
+    std::vector<Entry> entries;
+
+    // By bucket, empty when perfect() failed: the entries are then looked through
+    std::vector<uint32_t> seeds;
+};
+
+#endif
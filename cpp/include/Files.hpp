@@ -0,0 +1,12 @@
+#ifndef FILES__HPP
+#define FILES__HPP
+
+#include <string>
+
+// Reads the whole of path into contents, false when it can't
+bool read_file(const std::string& path, std::string& contents);
+
+// Name next to path no other thread nor process uses, for a file written aside then renamed into place
+std::string temporary_path(const std::string& path);
+
+#endif
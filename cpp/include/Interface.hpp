@@ -0,0 +1,141 @@
+#ifndef INTERFACE__HPP
+#define INTERFACE__HPP
+
+#include <AST/All.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compiled interface of a unit, unit.skyi next to unit.sky: the uses, the imports and the signatures of the top-level
+// declarations (no function bodies, no initializers). Importers use it instead of parsing the unit.
+//
+// The file is an array of 32 bit words in host order, every reference in it is a word offset from its start,
+// so it is used in place once mapped:
+//   header        "SKYI", version, byte order mark, surface, fingerprint,
+//                 then offset and count of dependencies, uses, imports, declarations, names, seeds and slots
+//   dependencies  (path, fingerprint) of the units the unit depends on, when it was written
+//   uses          (library, path)
+//   imports       (path, name count, names...)
+//   declarations  (name, record) per top-level declaration, in source order
+//   names         declaration indices sorted by name
+//   seeds, slots  minimal perfect hash of the distinct names (see Exports::perfect): a slot is where its name starts
+//                 in names. Both are empty when the hash could not be made, names are then searched.
+//   records       kind, name, line, column, references, then what the kind has, types inline
+//   strings       byte length then the bytes, padded to a word; strings are referred to relative to this section
+// A declaration is only built the first time it is asked for.
+//
+// The surface is a hash of what the declarations export: names, kinds, types, template parameters, fields and
+// layout attributes, not bodies, initializers nor locations. The initializer a variable's type is inferred from is the exception:
+// its source text is hashed, not written. The fingerprint adds those of the dependencies, see ModuleLoader::fingerprint.
+// Sizes are not kept, they depend on other units: importers lay the types out (see Layout).
+class Interface {
+public:
+    struct Dependency {
+        std::string path;
+        uint64_t fingerprint;
+    };
+
+    // FNV-1a, the same from a build to the next
+    static const uint64_t hash_basis = 14695981039346656037ULL;
+
+    static uint64_t hash(uint64_t hash, const void *data, size_t size) {
+        auto bytes = static_cast<const unsigned char*>(data);
+
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+
+        return hash;
+    }
+
+    // nullptr when path can't be read or is not an interface of this version
+    static std::unique_ptr<Interface> open(const std::string& path);
+
+    // The same for an interface in memory, used in place: data must outlive it and be aligned to 4 bytes
+    static std::unique_ptr<Interface> open(const char *data, size_t size);
+
+    // Whether the unit at path has an interface written after it, or no source.
+    // Times are compared in seconds: an interface written in the same second as its unit is not trusted.
+    static bool fresh(const std::string& path);
+
+    // Writes the interface of unit, false when path can't be written
+    static bool write(Unit *unit, uint64_t fingerprint, const std::vector<Dependency>& dependencies, const std::string& path);
+
+    // Surface of unit, as write() would store it
+    static uint64_t surface(Unit *unit);
+
+    ~Interface ();
+
+    Interface(Interface const&) = delete;
+    void operator=(Interface const&) = delete;
+
+    // A unit with only the uses and imports, errors about them are reported against it
+    std::unique_ptr<Unit> header(const std::string& path);
+
+    uint64_t surface() const {
+        return stored_surface;
+    }
+
+    uint64_t fingerprint() const {
+        return stored_fingerprint;
+    }
+
+    // Throws std::runtime_error for a corrupt file
+    std::vector<Dependency> dependencies() const;
+
+    // Top-level declarations
+    size_t size() const {
+        return declarations_count;
+    }
+
+    // Indices of the top-level declarations named name, in source order, nothing is built. One probe of the seeds and slots.
+    std::vector<size_t> find(const std::string& name) const;
+
+    // Top-level names the signature of declaration i refers to
+    std::vector<std::string> references(size_t i) const;
+
+    // Declaration i, built on the first call, the interface keeps it. Throws std::runtime_error for a corrupt file.
+    Declaration *declaration(size_t i);
+
+private:
+    Interface () {}
+
+    // Reads the header of what was mapped, false when it is not an interface of this version
+    bool start();
+
+    struct Cursor;
+    struct Writer;
+
+    std::string string(uint32_t ref) const;
+    uint32_t word(size_t at) const;
+
+    std::unique_ptr<Declaration> build(Cursor& cursor);
+    std::unique_ptr<Type> build_type(Cursor& cursor);
+    std::vector<TemplateDeclaration> build_templates(Cursor& cursor);
+
+    const uint32_t *words = nullptr;
+    size_t count = 0;
+
+    // What was mapped, or read when mapping is not available
+    void *mapping = nullptr;
+    size_t mapping_size = 0;
+    std::vector<uint32_t> copy;
+
+    uint64_t stored_surface = 0, stored_fingerprint = 0;
+
+    size_t dependencies_at = 0, dependencies_count = 0;
+    size_t uses_at = 0, uses_count = 0;
+    size_t imports_at = 0, imports_count = 0;
+    size_t declarations_at = 0, declarations_count = 0;
+    size_t names_at = 0;
+    size_t seeds_at = 0, seeds_count = 0;
+    size_t slots_at = 0, slots_count = 0;
+    size_t strings_at = 0;
+
+    std::vector<std::unique_ptr<Declaration>> built;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef LAYOUT__HPP
+#define LAYOUT__HPP
+
+#include <AST/All.hpp>
+#include <Errors.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Sizes, alignments and field offsets of types, as C lays them out: the fields of a struct in order, each at the next
+// multiple of its alignment, the struct as aligned as its most aligned field and its size a multiple of that.
+// A tuple is laid out the same, a variant is its tag (its from type, int32 or int64 otherwise) then room for its largest payload.
+// The fields of a [reorder] struct, or of every struct when reordering is asked for globally, are laid out by decreasing
+// alignment instead, which leaves no padding between them. They keep their order in StructDeclaration::fields:
+// a field's index, what a FieldAccess names, does not change, only its offset does.
+// [packed] on a struct or a field drops the alignment of its fields, [align(N)] raises that of a struct or a field to N:
+// fields aligned to 64, the size of a cache line, each start a line of their own, so threads writing them do not share one.
+//
+// The type declarations of a group of units are laid out together, once the units are bound (see Binder::signatures)
+// and those they depend on are laid out: sizes and offsets are set in the declarations, importers read them there.
+// Template instantiations are laid out with their arguments, memoized by declaration and layout of the arguments,
+// as are declarations. A type that contains itself other than through a pointer is reported and has no layout.
+class Layout {
+public:
+    Layout (bool _reorder = false) : reorder(_reorder) {}
+
+    struct Shape {
+        int size;
+        int alignment;
+
+        // Of the fields of a struct (-1 for static and extern ones) or the types of a tuple, of the tag and payload of a variant
+        std::vector<int> offsets;
+    };
+
+    // Type declarations in decls, those of a unit of the group, to be laid out by the next lay(), reported to errors.
+    // What was laid out in them before is forgotten: a resident unit may depend on units that changed.
+    void add(const std::vector<Declaration*>& decls, Unit *unit, ErrorHandler *errors);
+
+    void lay();
+
+    // Sets Sizeof::value in unit, once it is bound
+    void fold(Unit *unit, ErrorHandler *errors);
+
+    // Lowers the accesses to fields of elements of arrays of [soa] structs in unit, once it is bound, to strided ones:
+    // see FieldAccess::column. Such an array is still a pointer and a length, but to the columns of the fields one after
+    // the other, by decreasing alignment so that each starts aligned. Elements of a column are the size of its type apart,
+    // whatever the align and packed attributes: those are of the struct as a value.
+    // Only what declarations give a type to is lowered: variables, their fields and elements, through aliases.
+    void lower(Unit *unit);
+
+    // False when the layout of type is not known
+    bool of(Type *type, Shape& shape);
+
+    // A line per struct laid out in decls, declarations of the unit at path, with its size and what reordering its
+    // fields saved, or would save when it is not reordered and something would be
+    std::string report(const std::vector<Declaration*>& decls, const std::string& path);
+
+private:
+    struct Env;
+
+    struct Owner {
+        Unit *unit;
+        ErrorHandler *errors;
+    };
+
+    void own(Declaration *decl, const Owner& owner);
+
+    bool of(Type *type, const Env *env, Shape& shape);
+    bool declared(TypeDeclaration *decl, const std::vector<Shape>& args, Shape& shape);
+    bool lay_out(TypeDeclaration *decl, const Env *env, Shape& shape);
+    bool fields(StructDeclaration *decl, const Env *env, bool reordered, Shape& shape);
+    bool column(BaseType *element, const std::string& field, int& start, int& stride);
+
+    // Every struct is laid out as if it were [reorder]
+    bool reorder;
+
+    // By declaration and arguments, unknown layouts too (size -1)
+    std::unordered_map<std::string, Shape> shapes;
+
+    // Being laid out, a declaration met again contains itself
+    std::unordered_set<std::string> laying;
+    std::unordered_set<TypeDeclaration*> reported;
+
+    // Declarations of the group, laid out here, and those added since the last lay()
+    std::unordered_map<TypeDeclaration*, Owner> owned;
+    std::vector<TypeDeclaration*> pending;
+
+    // Where what is reported for declarations of other groups goes
+    ErrorHandler *errors = nullptr;
+};
+
+#endif
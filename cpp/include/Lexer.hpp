@@ -46,6 +46,9 @@ public:
     };
 
     Lexer (const char *_input);
+
+    // Resumes lexing at _start, which must be at the beginning of line _line of the input
+    Lexer (const char *_input, size_t length, const char *_start, int _line);
     Token nextToken();
     bool done() const;
     void nextLine();
@@ -0,0 +1,242 @@
+#ifndef MODULE_LOADER__HPP
+#define MODULE_LOADER__HPP
+
+#include <Lexer.hpp>
+#include <AST/Unit.hpp>
+#include <Bundle.hpp>
+#include <Cache.hpp>
+#include <CompilationContext.hpp>
+#include <Exports.hpp>
+#include <Interface.hpp>
+#include <ThreadPool.hpp>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Size and modification time of a file, and when it was looked at
+struct FileStamp {
+    long long size;
+    long long modified;
+    long long taken;
+
+    static FileStamp of(const std::string& path);
+
+    // Whether the file is still what it was, as far as size and time tell.
+    // Times are in seconds: a file modified in the second it was looked at may have changed since.
+    bool same(const FileStamp& now) const {
+        return size >= 0 && size == now.size && modified == now.modified && modified < taken;
+    }
+};
+
+// A unit of the build, read, lexed and parsed on any thread of the pool
+struct Module {
+    // Where the unit was found, normalized
+    std::string path;
+
+    // Position in ModuleLoader::modules() once loading is done
+    size_t id;
+
+    // Fork of the loader's context
+    std::unique_ptr<CompilationContext> context;
+
+    std::vector<Token> tokens;
+    std::unique_ptr<Unit> unit;
+
+    // When the unit was loaded from unit.skyi or from the cache, unit then only has the uses and imports
+    std::unique_ptr<Interface> interface;
+
+    // That unit, kept once ModuleLoader::reparse replaced it: reports and selections may point into it
+    std::unique_ptr<Unit> header;
+
+    // Hash of the version of the compiler, the path and the contents of the unit, when there is a cache
+    uint64_t key;
+
+    // Of the source when it was read
+    FileStamp stamp;
+
+    // Parsed from its source without reports, it may be kept for the next compilation (see ResidentUnits)
+    bool reusable;
+
+    // Taken back from ResidentUnits as it was, its file did not change
+    bool unchanged;
+
+    // Filled when Options::dump_tokens is set
+    std::string token_dump;
+
+    // Filled for roots when Options::layout_report is set, see Layout::report
+    std::string layout_report;
+
+    // Units named by the uses and imports, in source order, each once
+    std::vector<Module*> dependencies;
+
+    // Strongly connected component of the dependency graph, see ModuleLoader::schedule
+    size_t component;
+
+    bool root;
+
+    // Imports listing the declarations they want from this unit, with the unit they are in
+    struct Selection {
+        Module *importer;
+        Import *import;
+    };
+
+    std::vector<Selection> selections;
+
+    // Given on the command line, used or imported without a list
+    bool whole;
+
+    // Top-level declarations the importers see once loading is done, in source order:
+    // all of them when whole, the selected ones and those they reference otherwise
+    std::vector<Declaration*> visible;
+
+    // Those declarations frozen by name, made with them, binders of importers look them up there
+    std::unique_ptr<Exports> exports;
+
+    // Set by ModuleLoader::fingerprint
+    uint64_t surface;
+    uint64_t fingerprint;
+
+    // Fingerprints of the units outside the group it depends on, by path
+    std::vector<Interface::Dependency> outside;
+
+    // Its interface is up to date: neither the group, the options nor the fingerprints of the units outside changed since it was written
+    bool current;
+
+    // The library bundle it was found in, with its entry and that of its interface (Bundle::none when it has none)
+    Bundle *bundle;
+    size_t source_entry;
+    size_t interface_entry;
+};
+
+// Units a compile server keeps from a compilation to the next, by absolute path.
+// A unit is given back as it was when its file did not change, brought up to date by Parser::reparse when it did.
+class ResidentUnits {
+public:
+    ResidentUnits () : names(new Names()) {}
+
+    ResidentUnits(ResidentUnits const&) = delete;
+    void operator=(ResidentUnits const&) = delete;
+
+    // Moves the unit kept for module into it, false when there is none or it can't be brought up to date.
+    // The paths are relative to the current directory.
+    bool take(Module *module);
+
+    // Keeps the reusable units of modules, in place of those kept for the same paths
+    void keep(const std::vector<Module*>& modules);
+
+    // Interned by the compilations, given to the next ones: a name keeps its id from one to the next
+    std::shared_ptr<Names> names;
+
+private:
+    struct Entry {
+        FileStamp stamp;
+
+        // Options of the context it was parsed in
+        bool lazy_bodies;
+        bool recover_errors;
+        bool explicit_stack;
+        int max_nesting_depth;
+
+        std::vector<Token> tokens;
+        std::unique_ptr<Unit> unit;
+    };
+
+    std::mutex lock;
+    std::unordered_map<std::string, Entry> entries;
+};
+
+// Loads units and, transitively, the units they use and import, each exactly once, in parallel.
+// An import path is looked up next to the importing unit then in the import directories,
+// `use lib/path` in the library directories as lib/path.sky (lib.sky when there is no path),
+// or in the bundle lib.skyb of a library directory that has one (see Bundle).
+// Units that are not roots are parsed with lazy bodies, only the bodies of the declarations importers can see are parsed.
+// Their interface (see Interface) is used instead when it is up to date.
+// With a cache, any unit whose contents were compiled before is loaded from the interface the cache keeps for them.
+// With resident units, those of the previous compilations are taken back before anything else is tried.
+class ModuleLoader {
+public:
+    ModuleLoader (CompilationContext& _context, ThreadPool& _pool, Cache *_cache = nullptr, ResidentUnits *_resident = nullptr)
+        : context(_context), pool(_pool), cache(_cache), resident(_resident), loaded(false), linked(false) {}
+
+    ModuleLoader(ModuleLoader const&) = delete;
+    void operator=(ModuleLoader const&) = delete;
+
+    // Queues the units given on the command line, loading happens on the pool
+    void load(const std::vector<std::string>& paths);
+
+    // Waits for loading to finish and orders the modules: the roots as they were given, then the others by path
+    std::vector<Module*>& modules();
+
+    // Runs pass on every group of mutually dependent units once the groups they depend on are done.
+    // Groups are run on the pool, a unit without cycles is a group of its own.
+    void schedule(const std::function<void(std::vector<Module*>&)>& pass);
+
+    // Computes the surface, the fingerprint and whether the interface is current of every unit of a group given by schedule(),
+    // the groups it depends on must be fingerprinted. options hashes the options that change what units compile to,
+    // an interface written under others is not current.
+    void fingerprint(std::vector<Module*>& group, uint64_t options);
+
+    // Parses the source of a module loaded from an interface, for the passes that need all of it.
+    // False when it can't, reported to its context.
+    bool reparse(Module *module);
+
+    // Replays the reports of every module into the loader's context, in module order
+    void merge();
+
+    // Writes the library bundle at path, lib.skyb, of the roots: they must be units of library lib in its directory.
+    // Their interfaces are bundled with them when they are up to date. False when it can't, reported to the loader's context.
+    bool bundle(const std::string& path);
+
+private:
+    Module *create(const std::string& path, bool root);
+    Module *request(const std::string& path);
+    void read(Module *module);
+    bool parse(Module *module);
+    void lookup(Module *module);
+    Module *resolve(Module *module, const Node& node, const std::string& name, const std::vector<std::string>& candidates);
+    Bundle *library(const std::string& directory, const std::string& lib);
+    void select(Module *dependency, Module *importer, Import *import);
+    void materialize(Module *module, std::vector<std::pair<Module::Selection, std::string>>& missing);
+    void materialize_interface(Module *module, std::vector<std::pair<Module::Selection, std::string>>& missing);
+    void link();
+
+    CompilationContext& context;
+    ThreadPool& pool;
+    Cache *cache;
+    ResidentUnits *resident;
+
+    std::mutex lock;
+
+    // Library bundles by path, nullptr for those that could not be opened; they outlive the modules pointing in them
+    std::unordered_map<std::string, std::unique_ptr<Bundle>> bundles;
+
+    struct Bundled {
+        Bundle *bundle;
+        size_t source;
+        size_t interface;
+    };
+
+    // Units found in bundles, by path
+    std::unordered_map<std::string, Bundled> bundled;
+
+    std::unordered_map<std::string, Module*> by_path;
+    std::deque<std::unique_ptr<Module>> owned;
+    std::vector<Module*> roots;
+
+    // Set by modules()
+    std::vector<Module*> ordered;
+    bool loaded;
+
+    // Set by link(), dependencies first
+    std::vector<std::vector<Module*>> components;
+    bool linked;
+};
+
+#endif
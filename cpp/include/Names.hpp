@@ -0,0 +1,37 @@
+#ifndef NAMES__HPP
+#define NAMES__HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Names interned to ids, from 1 on, shared by the binders of a compilation and of its forks, and on a compile server
+// by the compilations that follow (see ResidentUnits): a name has the same id in every unit and every build.
+// Binders of several units use it at once, under a lock. Each binder keeps the ids it was given, see Binder.
+class Names {
+public:
+    Names () {}
+
+    Names(Names const&) = delete;
+    void operator=(Names const&) = delete;
+
+    // Id of name, hash being its hash, a new one when it has none yet
+    uint32_t intern(const std::string& name, uint64_t hash);
+
+    // Id of name, 0 when it has none
+    uint32_t find(const std::string& name, uint64_t hash) const;
+
+private:
+    size_t probe(const std::string& name, uint64_t hash) const;
+
+    mutable std::mutex lock;
+
+    // Names by id - 1, and the ids by hash of the name, open addressing
+    std::vector<std::string> names;
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> slots;
+};
+
+#endif
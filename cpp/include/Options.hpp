@@ -1,25 +1,152 @@
 #ifndef OPTIONS__HPP
 #define OPTIONS__HPP
 
-#include <Errors.hpp>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
 
+// Settings of a compilation, held by its CompilationContext
 class Options {
 public:
-    Options(Options const&) = delete;
-    void operator=(Options const&) = delete;
+    void read(int argc, char *argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            if (!strcmp(argv[i], "--recover-errors")) {
+                recover_errors = true;
+            } else if (!strncmp(argv[i], "--max-errors=", 13)) {
+                max_errors = strtoul(argv[i] + 13, nullptr, 10);
+            } else if (!strcmp(argv[i], "--lazy-bodies")) {
+                lazy_bodies = true;
+            } else if (!strcmp(argv[i], "--explicit-stack")) {
+                explicit_stack = true;
+            } else if (!strncmp(argv[i], "--max-nesting-depth=", 20)) {
+                max_nesting_depth = atoi(argv[i] + 20);
+            } else if (!strncmp(argv[i], "--parse-jobs=", 13)) {
+                parse_jobs = atoi(argv[i] + 13);
+            } else if (!strcmp(argv[i], "--dump-tokens")) {
+                dump_tokens = true;
+            } else if (!strncmp(argv[i], "--dump-format=", 14)) {
+                dump_format = argv[i] + 14;
+            } else if (!strncmp(argv[i], "--dump-depth=", 13)) {
+                dump_depth = atoi(argv[i] + 13);
+            } else if (!strncmp(argv[i], "--dump-kinds=", 13)) {
+                dump_kinds = argv[i] + 13;
+            } else if (!strcmp(argv[i], "--scan-deps")) {
+                scan_deps = true;
+            } else if (!strcmp(argv[i], "--emit-interface")) {
+                emit_interface = true;
+            } else if (!strncmp(argv[i], "--bundle=", 9)) {
+                bundle = argv[i] + 9;
+            } else if (!strncmp(argv[i], "--cache=", 8)) {
+                cache_dir = argv[i] + 8;
+            } else if (!strcmp(argv[i], "--reorder-fields")) {
+                reorder_fields = true;
+            } else if (!strcmp(argv[i], "--layout-report")) {
+                layout_report = true;
+            } else if (!strcmp(argv[i], "--watch")) {
+                watch = true;
+            } else if (!strncmp(argv[i], "--serve=", 8)) {
+                serve = argv[i] + 8;
+            } else if (!strncmp(argv[i], "--server=", 9)) {
+                server = argv[i] + 9;
+            } else if (!strncmp(argv[i], "-I", 2) || !strncmp(argv[i], "-L", 2)) {
+                // -Idir or -I dir
+                auto& dirs = argv[i][1] == 'I' ? import_dirs : library_dirs;
 
-    static Options& get() {
-        static Options instance;
-        return instance;
+                if (argv[i][2]) {
+                    dirs.push_back(argv[i] + 2);
+                } else if (i + 1 < argc) {
+                    dirs.push_back(argv[++i]);
+                }
+            } else if (!strncmp(argv[i], "-j", 2)) {
+                // -jN, -j N, or -j alone for a thread per core
+                if (argv[i][2]) {
+                    jobs = atoi(argv[i] + 2);
+                } else if (i + 1 < argc && isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                    jobs = atoi(argv[++i]);
+                } else {
+                    jobs = 0;
+                }
+            } else if (argv[i][0] != '-') {
+                inputs.push_back(argv[i]);
+            }
+        }
     }
 
-    void read(int argc, char *argv[]) {
-        err_handler = new DefaultErrorHandler();
-    }
+    // Units to compile, results come out in this order
+    std::vector<std::string> inputs;
+
+    // Where imported units are looked up, after the importing unit's directory (-I)
+    std::vector<std::string> import_dirs;
+
+    // Where used libraries are looked up (-L)
+    std::vector<std::string> library_dirs;
+
+    // Threads compiling units, 0 for one per core
+    int jobs = 1;
+
+    // Print the token stream of every unit
+    bool dump_tokens = false;
+
+    // What the AST of every unit is dumped as: dot, jsonl or binary, see DumpOptions
+    std::string dump_format = "dot";
+
+    // Depth of the dumped AST below its root, or below the root of each dumped subtree, -1 for no limit
+    int dump_depth = -1;
+
+    // Only dump the subtrees rooted at nodes of these kinds, comma separated Node::Kind names, empty for the whole AST
+    std::string dump_kinds;
+
+    // Only read the uses and imports of the units and print which units each one depends on, make style
+    bool scan_deps = false;
+
+    // Write unit.skyi next to every unit given on the command line that compiles, importers load it instead of the unit.
+    // Units whose interface is up to date and whose dependencies export what they did then are not compiled again.
+    bool emit_interface = false;
+
+    // Library bundle to write, lib.skyb, of the units given on the command line once they compiled, empty for none.
+    // They must be the units of library lib in the directory of the bundle, see Bundle.
+    std::string bundle;
+
+    // Where what units compile to is kept, keyed by their contents and the interfaces of their dependencies, empty for none.
+    // Several compilers may share it.
+    std::string cache_dir;
+
+    // Lay the fields of every struct out by decreasing alignment, as if they all were [reorder], see Layout
+    bool reorder_fields = false;
+
+    // Print the size of the structs of the units given on the command line and what reordering their fields saves
+    bool layout_report = false;
+
+    // Build again whenever a unit of the build changes, see Watcher
+    bool watch = false;
+
+    // Run as a compile server listening on this Unix socket, see Server
+    std::string serve;
+
+    // Have the compile server listening on this Unix socket compile, or compile here when there is none
+    std::string server;
+
+    // Errors kept before the parser gives up, 0 for no limit
+    size_t max_errors = 0;
+
+    // Parse expressions and nested scopes on heap allocated frames instead of the C++ stack
+    bool explicit_stack = false;
+
+    // Limit on productions nesting on the C++ stack (expressions, statements, scopes, types)
+    int max_nesting_depth = 1024;
+
+    // Skip function bodies by brace matching, they are parsed the first time Parser::body asks for them
+    bool lazy_bodies = false;
+
+    // Threads parsing the top-level declarations of a unit, 1 parses them on the calling thread
+    int parse_jobs = 1;
 
-    ErrorHandler *err_handler;
-private:
-    Options() {};
+    // Report every syntax error: the parser skips what it could not parse up to the next statement or declaration,
+    // leaves a SyntaxError node in its place and goes on
+    bool recover_errors = false;
 };
 
 #endif
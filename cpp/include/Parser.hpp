@@ -3,25 +3,69 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 
 #include <Lexer.hpp>
 #include <AST/All.hpp>
 #include <Errors.hpp>
+#include <CompilationContext.hpp>
 
 // Skylang parser that generates an AST
 
+// Replaces length bytes at offset in a unit's contents with text
+struct TextEdit {
+    size_t offset;
+    size_t length;
+    std::string text;
+};
+
 class Parser {
 public:
-    Parser (Token *_stream);
+    Parser (CompilationContext& _context, Token *_stream);
 
     // This will return an AST eventually
     std::unique_ptr<Unit> unit(std::string path, char *contents);
+
+    // Only the uses and imports at the top of a unit, the stream may end (END) right after them
+    std::unique_ptr<Unit> header(std::string path, char *contents);
+
+    // Body of a function declaration, parsing it first if it was skipped by a lazy parse
+    static Scope *body(FunctionDeclaration *fDecl);
+
+    // Applies edits (non overlapping, offsets in the current contents) to a unit and its token stream.
+    // Only the lines around the edits are lexed again and only the top-level declarations they touch are parsed again,
+    // the other declarations are kept. Returns false and leaves both untouched if the new contents do not parse.
+    static bool reparse(CompilationContext& context, std::unique_ptr<Unit>& unit, std::vector<Token>& tokens, std::vector<TextEdit> edits);
 private:
     Token *stream;
     Token *cursor;
 
     Unit *curr_unit;
 
+    // Top-level declaration the new nodes belong to, see Unit::index
+    uint32_t owner;
+
+    CompilationContext *context;
+
+    // Copied from the context's Options, see there
+    bool explicit_stack;
+    int max_depth;
+    bool lazy_bodies;
+    int jobs;
+    bool recover;
+
+    // Thrown by raise() for errors, caught where parsing can resume (see Options::recover_errors) or gives up
+    struct Recovery {
+        std::string message;
+    };
+
+    ErrorHandler *err_handler;
+
+    // Current nesting of recursive productions
+    int depth;
+    struct Nesting;
+    bool too_deep();
+
     bool accept(int id);
     bool accept_rewind(int id);
     bool consumeAll(int id);
@@ -33,6 +77,14 @@ private:
     Import *import();
 
     Declaration *declaration();
+    bool top_level_declaration(Unit *unit);
+    static bool declaration_start(Token *tok);
+    void skip_declaration();
+    void skip_statement();
+    SyntaxError *syntax_error(Token *start, const std::string& message);
+    void adopt(Unit *unit, Unit& piece, size_t at);
+    std::vector<Token*> declaration_bounds();
+    bool parallel_declarations(Unit *unit);
     NamespaceDeclaration *namespace_();
 
     TypeDeclaration *typeDecl();
@@ -41,8 +93,14 @@ private:
     VariantDeclaration *variantDecl();
 
     bool templateDef(std::vector<TemplateDeclaration>& templates);
+    struct Attribute;
+    bool attributes(std::vector<Attribute>& list);
+    bool layoutAttribute(const Attribute& attribute, int& align, bool& packed);
+    void structAttributes(StructDeclaration *decl);
+    VariableDeclaration *field();
 
     FunctionDeclaration *funcDecl();
+    bool skip_body(FunctionDeclaration *fDecl);
 
     void func_decl_return_type(FunctionDeclaration *fDecl);
     void arglist_def_man_names(FunctionDeclaration *parent, std::vector<std::unique_ptr<VariableDeclaration>>& arglist);
@@ -61,7 +119,10 @@ private:
     bool closure_function_type_common(std::vector<std::unique_ptr<Type>>& argTypes, Type **retType);
 
     Scope *scope();
+    Scope *flatScope();
     Statement *statement();
+    Statement *scope_statement();
+    bool scope_end();
 
     VariableDeclaration *variableDecl();
 
@@ -98,6 +159,14 @@ private:
     Expression *prefix();
     Expression *postfix();
     Expression *atom();
+
+    // Shared by the recursive productions and flatExpression
+    Expression *cast_ops(Expression *curr, Token *start);
+    Expression *postfix_ops(Expression *curr, Token *start);
+    Expression *sizeof_rest(Token *start);
+    static int binary_precedence(int id);
+
+    Expression *flatExpression();
     FloatLiteral *floatLiteral();
     IntLiteral *intLiteral();
     CharLiteral *charLiteral();
@@ -117,9 +186,18 @@ private:
 
     void raise(const Token& token, const std::string& message, ErrorLevel level = ErrorLevel::Error);
     void raise(const std::string& message, ErrorLevel level = ErrorLevel::Error);
+    void raise(const Token& token, const char *message, ErrorLevel level = ErrorLevel::Error);
 
     Token *last();
 
+    // Allocates a node and records it in the current unit's kind index
+    template <typename T, typename... Args>
+    T *make(Args&&... args) {
+        T *node = new T(std::forward<Args>(args)...);
+        curr_unit->index(node, owner);
+        return node;
+    }
+
     std::vector<Token*> token_stack;
 };
 
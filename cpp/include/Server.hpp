@@ -0,0 +1,26 @@
+#ifndef SERVER__HPP
+#define SERVER__HPP
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Compile server on a Unix socket. A client sends its working directory and its arguments,
+// the server compiles in that directory and sends back what it prints, as it prints it, then the exit status.
+// Requests are served one at a time, so the server may keep what it read from one to the next.
+class Server {
+public:
+    // Compiles with the given arguments, printing to out, returns the exit status
+    typedef std::function<int(std::vector<std::string>& args, std::ostream& out)> Compile;
+
+    // Serves until the socket fails, returns the exit status. A file left at path by a server that is gone is replaced,
+    // it fails when a server answers there.
+    static int serve(const std::string& path, const Compile& compile);
+
+    // Has the server at path compile args in the current directory and prints what it sends back.
+    // Returns the exit status of the compilation, -1 when there is no server to connect to.
+    static int forward(const std::string& path, const std::vector<std::string>& args);
+};
+
+#endif
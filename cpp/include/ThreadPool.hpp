@@ -0,0 +1,63 @@
+#ifndef THREAD_POOL__HPP
+#define THREAD_POOL__HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker has a deque of tasks, it runs the newest of its own first
+// and steals the oldest of another worker when it has none left. Tasks may submit more tasks.
+// The thread calling wait() works too, so a pool of n runs n - 1 threads of its own.
+class ThreadPool {
+public:
+    ThreadPool (int _threads);
+    ~ThreadPool ();
+
+    ThreadPool(ThreadPool const&) = delete;
+    void operator=(ThreadPool const&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Runs tasks until all of them are done, those submitted meanwhile included.
+    // Rethrows the first exception a task let out, the other tasks still run.
+    void wait();
+
+    size_t size() const {
+        return workers.size();
+    }
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool take(size_t self, std::function<void()>& task);
+    void run(std::function<void()>& task);
+    void work(size_t self);
+
+    // workers[0] belongs to the threads outside the pool
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex idle_lock;
+    std::condition_variable idle;
+
+    // Tasks in the deques, and tasks submitted but not done
+    std::atomic<size_t> queued;
+    std::atomic<size_t> pending;
+
+    std::atomic<size_t> next_worker;
+    bool stop;
+
+    std::exception_ptr exception;
+};
+
+#endif
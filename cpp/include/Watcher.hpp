@@ -0,0 +1,66 @@
+#ifndef WATCHER__HPP
+#define WATCHER__HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Watches directories for units (.sky files) being written, moved or removed, with inotify.
+// Events are read on a thread of the watcher's own as they come, so a build can see it is outdated while it runs.
+class Watcher {
+public:
+    // Fails (see ok()) where there is no inotify
+    Watcher ();
+    ~Watcher ();
+
+    Watcher(Watcher const&) = delete;
+    void operator=(Watcher const&) = delete;
+
+    bool ok() const {
+        return fd >= 0;
+    }
+
+    // Watches directory ("" for the current one), once however many times it is added
+    void add(const std::string& directory);
+
+    // Takes unit as unchanged while the hash of its contents (see Interface::hash) is the one given, 0 when not known
+    void know(const std::string& unit, uint64_t hash);
+
+    // Waits for units to change, then for quiet milliseconds without any other event, and gives them all at once.
+    // A unit written again with the same contents is no change, it is told by a hash of the contents.
+    // With any, gives the units of the events even when none changed.
+    std::set<std::string> wait(int quiet = 100, bool any = false);
+
+    // Set as soon as an event comes, cleared by wait()
+    const std::atomic<bool>& changed() const {
+        return pending;
+    }
+
+private:
+    void run();
+
+    int fd;
+    std::thread thread;
+    std::atomic<bool> stop;
+
+    std::mutex lock;
+    std::condition_variable event;
+
+    // Directory of each watch
+    std::unordered_map<int, std::string> directories;
+
+    // Paths of the events not given by wait() yet, and how many events there were
+    std::set<std::string> paths;
+    uint64_t events;
+    std::atomic<bool> pending;
+
+    // Contents hash of the units when they were last given
+    std::unordered_map<std::string, uint64_t> hashes;
+};
+
+#endif
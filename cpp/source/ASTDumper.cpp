@@ -1,48 +1,332 @@
 #include <ASTDumper.hpp>
 
-ASTDumper::ASTDumper (Node *root, std::string outpath) {
-    file = fopen(outpath.c_str(), "w");
+#include <stdexcept>
+
+// Names of Node::Kind, in its order
+static const char *kind_names[node_kind_count] = {
+    "Unit", "Use", "Import", "NamespaceDecl", "FuncDecl",
+    "TemplateDecl",
+    "StructDecl", "VariableDecl", "AliasDecl", "VariantDecl",
+    "SyntaxError",
+    "BaseType", "ArrayType", "PointerType", "ClosureType", "FuncType", "TupleType",
+    "Scope", "IfStmt", "WhileStmt", "ForStmt", "ReturnStmt", "UsingStmt",
+    "BreakStmt", "ContinueStmt",
+    "DeferStmt", "MatchStmt",
+    "VariableAcc", "FieldAcc",
+    "BoolLit", "StringLit", "CharLit", "IntLit", "NullLit", "FloatLit",
+    "ArrayIndexing", "FuncCall", "Sizeof", "UnaryOp", "BinaryOp",
+    "Cast", "IfExpr", "IsExpr",
+    "Ass"
+};
+
+bool DumpOptions::read(const std::string& format_name, int depth, const std::string& kinds) {
+    if (format_name == "dot") {
+        format = Format::Dot;
+    } else if (format_name == "jsonl") {
+        format = Format::JsonLines;
+    } else if (format_name == "binary") {
+        format = Format::Binary;
+    } else {
+        return false;
+    }
+
+    max_depth = depth;
+    subtree_kinds.reset();
+
+    for (size_t start = 0; start < kinds.size(); ) {
+        size_t end = kinds.find(',', start);
+        if (end == std::string::npos) {
+            end = kinds.size();
+        }
+
+        std::string name = kinds.substr(start, end - start);
+        start = end + 1;
+
+        size_t kind = 0;
+        while (kind < node_kind_count && name != kind_names[kind]) {
+            kind++;
+        }
+
+        if (kind == node_kind_count) {
+            return false;
+        }
+
+        subtree_kinds.set(kind);
+    }
+
+    return true;
+}
+
+const char *DumpOptions::extension() const {
+    switch (format) {
+        case Format::JsonLines:
+            return ".jsonl";
+        case Format::Binary:
+            return ".skya";
+        default:
+            return ".dot";
+    }
+}
+
+ASTDumper::ASTDumper (Node *root, std::string outpath) : ASTDumper(root, outpath, DumpOptions()) {}
+
+ASTDumper::ASTDumper (Node *root, std::string outpath, const DumpOptions& _options) : options(_options) {
+    file = fopen(outpath.c_str(), options.format == DumpOptions::Format::Binary ? "wb" : "w");
+    if (!file) {
+        throw std::runtime_error("Could not open " + outpath + " for writing.");
+    }
+
+    out = std::unique_ptr<BufferedWriter>(new BufferedWriter(file));
+
     nodeCounter = 0;
+    parent_id = -1;
+    desc = nullptr;
 
-    writeln("digraph {");
+    depth = 0;
+    depth_base = 0;
+    inside = options.subtree_kinds.none();
+    subtree_root = 0;
 
-    root->accept(*this);
+    dump(root);
 
-    writeln("}");
+    out->flush();
     fclose(file);
 }
 
-void ASTDumper::write(const std::string& str) {
-    fwrite(str.data(), str.size(), 1, file);
+void ASTDumper::dump(Node *root) {
+    if (options.format == DumpOptions::Format::Dot) {
+        out->write("digraph {\n");
+    } else if (options.format == DumpOptions::Format::Binary) {
+        out->write("SKYA\2");
+    }
+
+    visit(root);
+
+    if (options.format == DumpOptions::Format::Dot) {
+        out->write("}\n");
+    }
 }
 
-void ASTDumper::writeln(const std::string& str) {
-    write(str + '\n');
+// Every child node goes through here so we can apply the depth and subtree filters.
+// Ids are handed out in walk order, so a subtree always covers the ids from its root's onwards;
+// that is how edges leaving a selected subtree are recognized.
+void ASTDumper::visit(Node *n) {
+    bool entered = false;
+
+    if (!inside && options.subtree_kinds.test(static_cast<size_t>(n->kind))) {
+        inside = true;
+        entered = true;
+        depth_base = depth;
+        subtree_root = nodeCounter;
+    }
+
+    if (inside && options.max_depth >= 0 && depth - depth_base > options.max_depth) {
+        desc = nullptr;
+        return;
+    }
+
+    depth++;
+    n->accept(*this);
+    depth--;
+
+    if (entered) {
+        inside = false;
+    }
 }
 
-int ASTDumper::node(const std::string& text) {
-    writeln("node" + std::to_string(nodeCounter) + " [label=\"" + text + "\"]");
-    return nodeCounter++;
+inline bool ASTDumper::emitting() {
+    return inside;
 }
 
-int ASTDumper::record(std::initializer_list<std::string> values) {
-    std::string buff;
-    buff += "node" + std::to_string(nodeCounter) + "[shape=record, label=\"{";
+void ASTDumper::label(const char *text, size_t length) {
+    const char *end = text + length;
 
-    bool first = true;
+    if (options.format == DumpOptions::Format::Binary) {
+        // Strings are NUL terminated, so a backslash is spelled \\ and the NUL of a char literal \0
+        const char *run = text;
+        for (const char *i = text; i < end; ++i) {
+            if (*i != '\0' && *i != '\\') {
+                continue;
+            }
+
+            out->write(run, i - run);
+            out->write(*i ? "\\\\" : "\\0");
+            run = i + 1;
+        }
+
+        out->write(run, end - run);
+        return;
+    }
+
+    // Write unescaped runs in one go
+    const char *run = text;
+    for (const char *i = text; i < end; ++i) {
+        char c = *i;
+
+        if (c != '"' && c != '\\' && (unsigned char) c >= 0x20) {
+            continue;
+        }
 
-    for (auto& val: values) {
-        if (first) {
-            first =  false;
+        out->write(run, i - run);
+        run = i + 1;
+
+        if (c == '"' || c == '\\') {
+            out->write('\\');
+            out->write(c);
+        } else if (c == '\n') {
+            out->write("\\n");
+        } else if (options.format == DumpOptions::Format::JsonLines) {
+            static const char hex[] = "0123456789abcdef";
+            out->write("\\u00");
+            out->write(hex[(c >> 4) & 0xF]);
+            out->write(hex[c & 0xF]);
         } else {
-            buff += '|';
+            out->write(' ');
         }
+    }
+
+    out->write(run, end - run);
+}
+
+void ASTDumper::label(const char *text) {
+    label(text, strlen(text));
+}
+
+void ASTDumper::label(const std::string& text) {
+    label(text.data(), text.size());
+}
+
+void ASTDumper::string_end() {
+    if (options.format == DumpOptions::Format::Binary) {
+        out->write('\0');
+    } else {
+        out->write('"');
+    }
+}
 
-        buff += val;
+// Starts a node record, the caller then writes the label pieces and calls end_node.
+int ASTDumper::begin_node() {
+    if (emitting()) {
+        if (options.format == DumpOptions::Format::Dot) {
+            out->write("node");
+            out->write_int(nodeCounter);
+            out->write(" [label=\"");
+        } else if (options.format == DumpOptions::Format::JsonLines) {
+            out->write("{\"node\":");
+            out->write_int(nodeCounter);
+            out->write(",\"label\":\"");
+        } else {
+            out->write('N');
+            out->write_varint(nodeCounter);
+        }
+    }
+
+    return nodeCounter++;
+}
+
+void ASTDumper::end_node() {
+    string_end();
+
+    if (options.format == DumpOptions::Format::Dot) {
+        out->write("]\n");
+    } else if (options.format == DumpOptions::Format::JsonLines) {
+        out->write("}\n");
+    }
+}
+
+int ASTDumper::node(const char *text) {
+    int id = begin_node();
+    if (emitting()) {
+        label(text);
+        end_node();
+    }
+    return id;
+}
+
+int ASTDumper::node(const std::string& text) {
+    int id = begin_node();
+    if (emitting()) {
+        label(text);
+        end_node();
+    }
+    return id;
+}
+
+int ASTDumper::node(const char *prefix, const std::string& text) {
+    int id = begin_node();
+    if (emitting()) {
+        label(prefix);
+        label(text);
+        end_node();
+    }
+    return id;
+}
+
+int ASTDumper::node(int64_t value) {
+    int id = begin_node();
+    if (emitting()) {
+        out->write_int(value);
+        end_node();
+    }
+    return id;
+}
+
+int ASTDumper::record(std::initializer_list<std::pair<const char*, int64_t>> fields) {
+    if (!emitting()) {
+        return nodeCounter++;
+    }
+
+    if (options.format == DumpOptions::Format::Dot) {
+        out->write("node");
+        out->write_int(nodeCounter);
+        out->write("[shape=record, label=\"{");
+
+        bool first = true;
+        for (auto& field: fields) {
+            if (first) {
+                first = false;
+            } else {
+                out->write('|');
+            }
+
+            label(field.first);
+            out->write(": ");
+            out->write_int(field.second);
+        }
+
+        out->write("}\"]\n");
+    } else if (options.format == DumpOptions::Format::JsonLines) {
+        out->write("{\"record\":");
+        out->write_int(nodeCounter);
+        out->write(",\"fields\":{");
+
+        bool first = true;
+        for (auto& field: fields) {
+            if (first) {
+                first = false;
+            } else {
+                out->write(',');
+            }
+
+            out->write('"');
+            label(field.first);
+            out->write("\":");
+            out->write_int(field.second);
+        }
+
+        out->write("}}\n");
+    } else {
+        out->write('R');
+        out->write_varint(nodeCounter);
+        out->write_varint(fields.size());
+
+        for (auto& field: fields) {
+            label(field.first);
+            string_end();
+            out->write_svarint(field.second);
+        }
     }
 
-    buff += "}\"]";
-    writeln(buff);
     return nodeCounter++;
 }
 
@@ -50,17 +334,56 @@ int ASTDumper::current() {
     return nodeCounter;
 }
 
-void ASTDumper::child(const std::string& _desc) {
+void ASTDumper::child(const char *_desc) {
     desc = _desc;
 }
 
 void ASTDumper::edge(int a, int b) {
-    std::string buff = "node" + std::to_string(a) + " -> node" + std::to_string(b);
-    if (!desc.empty()) {
-        buff += " [label=\"" + desc + "\"]";
-        desc.clear();
+    // Edges coming from outside of the selected subtree are dropped along with their source
+    if (!emitting() || a < subtree_root) {
+        desc = nullptr;
+        return;
+    }
+
+    if (options.format == DumpOptions::Format::Dot) {
+        out->write("node");
+        out->write_int(a);
+        out->write(" -> node");
+        out->write_int(b);
+
+        if (desc) {
+            out->write(" [label=\"");
+            label(desc);
+            out->write("\"]");
+        }
+
+        out->write('\n');
+    } else if (options.format == DumpOptions::Format::JsonLines) {
+        out->write("{\"edge\":[");
+        out->write_int(a);
+        out->write(',');
+        out->write_int(b);
+        out->write(']');
+
+        if (desc) {
+            out->write(",\"label\":\"");
+            label(desc);
+            out->write('"');
+        }
+
+        out->write("}\n");
+    } else {
+        out->write('E');
+        out->write_varint(a);
+        out->write_varint(b);
+
+        if (desc) {
+            label(desc);
+        }
+        string_end();
     }
-    writeln(buff);
+
+    desc = nullptr;
 }
 
 void ASTDumper::walk(Unit *unit) {
@@ -68,26 +391,34 @@ void ASTDumper::walk(Unit *unit) {
 
     for (auto& use: unit->uses) {
         child("use");
-        use->accept(*this);
+        visit(use.get());
     }
 
     for (auto& import: unit->imports) {
         child("import");
-        import->accept(*this);
+        visit(import.get());
     }
 
     for (auto& decl: unit->decls) {
         child("decl");
-        decl->accept(*this);
+        visit(decl.get());
     }
 }
 
 void ASTDumper::walk(Use *use) {
-    edge(parent_id, node(use->str()));
+    int id = begin_node();
+    if (emitting()) {
+        label("use ");
+        label(use->lib_name);
+        label("/");
+        label(use->unit_path);
+        end_node();
+    }
+    edge(parent_id, id);
 }
 
 void ASTDumper::walk(Import *import) {
-    edge(parent_id, node(import->str()));
+    edge(parent_id, node("import ", import->unit_path + import->selection()));
 }
 
 void ASTDumper::walk(TemplateDeclaration *temp) {
@@ -97,12 +428,12 @@ void ASTDumper::walk(TemplateDeclaration *temp) {
 void ASTDumper::walk(NamespaceDeclaration *ns) {
     int parent = parent_id;
 
-    parent_id = node(ns->str());
+    parent_id = node("namespace ", ns->name);
     edge(parent, parent_id);
 
     for (auto& decl: ns->decls) {
         child("decl");
-        decl->accept(*this);
+        visit(decl.get());
     }
 
     parent_id = parent;
@@ -111,20 +442,20 @@ void ASTDumper::walk(NamespaceDeclaration *ns) {
 void ASTDumper::walk(VariableDeclaration *vDecl) {
     int parent = parent_id;
 
-    parent_id = node("var_decl " + vDecl->name);
+    parent_id = node("var_decl ", vDecl->name);
     edge(parent, parent_id);
 
     child("modifiers");
-    edge(parent_id, record({ "extern: " + std::to_string(vDecl->extern_mod), "static: " + std::to_string(vDecl->static_mod) }));
+    edge(parent_id, record({ { "extern", vDecl->extern_mod }, { "static", vDecl->static_mod } }));
 
     if (vDecl->type) {
         child("type");
-        vDecl->type->accept(*this);
+        visit(vDecl->type.get());
     }
 
     if (vDecl->init_expr) {
         child("init_expr");
-        vDecl->init_expr->accept(*this);
+        visit(vDecl->init_expr.get());
     }
 
     parent_id = parent;
@@ -133,22 +464,22 @@ void ASTDumper::walk(VariableDeclaration *vDecl) {
 void ASTDumper::walk(StructDeclaration *decl) {
     int parent = parent_id;
 
-    parent_id = node("struct_decl " + decl->name);
+    parent_id = node("struct_decl ", decl->name);
     edge(parent, parent_id);
 
     for (auto& temp: decl->templates) {
         child("template");
-        temp.accept(*this);
+        visit(&temp);
     }
 
     for (auto& sdecl: decl->subdecls) {
         child("sub_decl");
-        sdecl->accept(*this);
+        visit(sdecl.get());
     }
 
     for (auto& field: decl->fields) {
         child("field");
-        field->accept(*this);
+        visit(field.get());
     }
 
     parent_id = parent;
@@ -157,15 +488,15 @@ void ASTDumper::walk(StructDeclaration *decl) {
 void ASTDumper::walk(AliasDeclaration *decl) {
     int parent = parent_id;
 
-    parent_id = node("alias_decl " + decl->name);
+    parent_id = node("alias_decl ", decl->name);
     edge(parent, parent_id);
 
     child("from_type");
-    decl->from_type->accept(*this);
+    visit(decl->from_type.get());
 
     for (auto& temp: decl->templates) {
         child("template");
-        temp.accept(*this);
+        visit(&temp);
     }
 
     parent_id = parent;
@@ -174,54 +505,79 @@ void ASTDumper::walk(AliasDeclaration *decl) {
 void ASTDumper::walk(VariantDeclaration *decl) {
     int parent = parent_id;
 
-    parent_id = node("variant_decl " + decl->name);
+    parent_id = node("variant_decl ", decl->name);
     edge(parent, parent_id);
 
     if (decl->from_type) {
         child("from_type");
-        decl->from_type->accept(*this);
+        visit(decl->from_type.get());
     }
 
     for (auto& sdecl: decl->subdecls) {
         child("sub_decl");
-        sdecl->accept(*this);
+        visit(sdecl.get());
     }
 
     for (auto& field: decl->fields) {
+        int loop_parent = parent_id;
+
+        parent_id = begin_node();
+        if (emitting()) {
+            label(field.name);
+            label(" = ");
+            out->write_int(field.value);
+            end_node();
+        }
+
         child("member");
-        edge(parent_id, node(field.str()));
+        edge(loop_parent, parent_id);
+
+        if (field.type) {
+            child("type");
+            visit(field.type.get());
+        }
+
+        parent_id = loop_parent;
     }
 
     parent_id = parent;
 }
 
+void ASTDumper::walk(SyntaxError *error) {
+    edge(parent_id, node("syntax_error ", error->message));
+}
+
 void ASTDumper::walk(FunctionDeclaration *decl) {
     int parent = parent_id;
 
-    parent_id = node("func_decl " + decl->name);
+    parent_id = node("func_decl ", decl->name);
     edge(parent, parent_id);
 
     child("modifiers");
-    edge(parent_id, record({ "extern: " + std::to_string(decl->is_extern), "inline: " + std::to_string(decl->is_inline) }));
+    edge(parent_id, record({ { "extern", decl->is_extern }, { "inline", decl->is_inline } }));
 
     for (auto& temp: decl->templates) {
         child("template");
-        temp.accept(*this);
+        visit(&temp);
     }
 
     for (auto& arg: decl->arglist) {
         child("arg");
-        arg->accept(*this);
+        visit(arg.get());
     }
 
     if (decl->return_type) {
         child("return_type");
-        decl->return_type->accept(*this);
+        visit(decl->return_type.get());
     }
 
     if (decl->body) {
         child("body");
-        decl->body->accept(*this);
+        visit(decl->body.get());
+    } else if (decl->body_pending() && (options.max_depth < 0 || depth - depth_base <= options.max_depth)) {
+        // Skipped by a lazy parse and never asked for, dumping leaves the AST as it is
+        child("body");
+        edge(parent_id, node("unparsed_body"));
     }
 
     parent_id = parent;
@@ -235,7 +591,7 @@ void ASTDumper::walk(Scope *scope) {
 
     for (auto& stmt: scope->statements) {
         child("stmt");
-        stmt->accept(*this);
+        visit(stmt.get());
     }
 
     parent_id = parent;
@@ -248,14 +604,14 @@ void ASTDumper::walk(IfStmt *ifS) {
     edge(parent, parent_id);
 
     child("condition");
-    ifS->condition->accept(*this);
+    visit(ifS->condition.get());
 
     child("if_stmt");
-    ifS->ifStmt->accept(*this);
+    visit(ifS->ifStmt.get());
 
     if (ifS->elseStmt) {
         child("else_stmt");
-        ifS->elseStmt->accept(*this);
+        visit(ifS->elseStmt.get());
     }
 
     parent_id = parent;
@@ -264,14 +620,14 @@ void ASTDumper::walk(IfStmt *ifS) {
 void ASTDumper::walk(WhileStmt *whSt) {
     int parent = parent_id;
 
-    parent_id = node("while " + whSt->label);
+    parent_id = node("while ", whSt->label);
     edge(parent, parent_id);
 
     child("condition");
-    whSt->condition->accept(*this);
+    visit(whSt->condition.get());
 
     child("body");
-    whSt->body->accept(*this);
+    visit(whSt->body.get());
 
     parent_id = parent;
 }
@@ -279,24 +635,24 @@ void ASTDumper::walk(WhileStmt *whSt) {
 void ASTDumper::walk(ForStmt *fS) {
     int parent = parent_id;
 
-    parent_id = node("for " + fS->label);
+    parent_id = node("for ", fS->label);
     edge(parent, parent_id);
 
     child("init_scope");
-    fS->initScope->accept(*this);
+    visit(fS->initScope.get());
 
     if (fS->condition) {
         child("condition");
-        fS->condition->accept(*this);
+        visit(fS->condition.get());
     }
 
     if (fS->loopExpr) {
         child("loop_expr");
-        fS->loopExpr->accept(*this);
+        visit(fS->loopExpr.get());
     }
 
     child("body");
-    fS->body->accept(*this);
+    visit(fS->body.get());
 
     parent_id = parent;
 }
@@ -307,8 +663,10 @@ void ASTDumper::walk(ReturnStmt *ret) {
     parent_id = node("return");
     edge(parent, parent_id);
 
-    child("expr");
-    ret->expr->accept(*this);
+    if (ret->expr) {
+        child("expr");
+        visit(ret->expr.get());
+    }
 
     parent_id = parent;
 }
@@ -316,23 +674,23 @@ void ASTDumper::walk(ReturnStmt *ret) {
 void ASTDumper::walk(UsingStmt *us) {
     int parent = parent_id;
 
-    parent_id = node("using " + us->name);
+    parent_id = node("using ", us->name);
     edge(parent, parent_id);
 
     if (us->scope) {
         child("body");
-        us->scope->accept(*this);
+        visit(us->scope.get());
     }
 
     parent_id = parent;
 }
 
 void ASTDumper::walk(BreakStmt *bs) {
-    edge(parent_id, node(bs->str()));
+    edge(parent_id, bs->label.empty() ? node("break") : node("break ", bs->label));
 }
 
 void ASTDumper::walk(ContinueStmt *cs) {
-    edge(parent_id, node(cs->str()));
+    edge(parent_id, cs->label.empty() ? node("continue") : node("continue ", cs->label));
 }
 
 void ASTDumper::walk(DeferStmt *defer) {
@@ -342,7 +700,7 @@ void ASTDumper::walk(DeferStmt *defer) {
     edge(parent, parent_id);
 
     child("body");
-    defer->scope->accept(*this);
+    visit(defer->scope.get());
 
     parent_id = parent;
 }
@@ -354,7 +712,7 @@ void ASTDumper::walk(MatchStmt *match) {
     edge(parent, parent_id);
 
     child("matched_expr");
-    match->matched_expr->accept(*this);
+    visit(match->matched_expr.get());
 
     for (auto& ca: match->cases) {
         int loop_parent = parent_id;
@@ -362,7 +720,7 @@ void ASTDumper::walk(MatchStmt *match) {
         if (ca.kind == Case::Kind::Simple) {
             parent_id = node("case");
             child("expr");
-            ca.expr->accept(*this);
+            visit(ca.expr.get());
         } else {
             parent_id = node("case is");
             child("tag");
@@ -370,12 +728,12 @@ void ASTDumper::walk(MatchStmt *match) {
 
             for (auto& rule: ca.exprs) {
                 child("rule");
-                rule->accept(*this);
+                visit(rule.get());
             }
         }
 
         child("body");
-        ca.body->accept(*this);
+        visit(ca.body.get());
 
         child("case");
         edge(loop_parent, parent_id);
@@ -385,7 +743,7 @@ void ASTDumper::walk(MatchStmt *match) {
 
     if (match->else_scope) {
         child("else_body");
-        match->else_scope->accept(*this);
+        visit(match->else_scope.get());
     }
 
     parent_id = parent;
@@ -399,12 +757,12 @@ void ASTDumper::walk(ClosureType *ct) {
 
     for (auto& arg_type: ct->argTypes) {
         child("arg_type");
-        arg_type->accept(*this);
+        visit(arg_type.get());
     }
 
     if (ct->returnType) {
         child("return_type");
-        ct->returnType->accept(*this);
+        visit(ct->returnType.get());
     }
 
     parent_id = parent;
@@ -418,7 +776,7 @@ void ASTDumper::walk(TupleType *type) {
 
     for (auto& t: type->types) {
         child("type");
-        t->accept(*this);
+        visit(t.get());
     }
 
     parent_id = parent;
@@ -432,12 +790,12 @@ void ASTDumper::walk(FunctionType *ft) {
 
     for (auto& arg_type: ft->argTypes) {
         child("arg_type");
-        arg_type->accept(*this);
+        visit(arg_type.get());
     }
 
     if (ft->returnType) {
         child("return_type");
-        ft->returnType->accept(*this);
+        visit(ft->returnType.get());
     }
 
     parent_id = parent;
@@ -450,7 +808,7 @@ void ASTDumper::walk(PointerType *pt) {
     edge(parent, parent_id);
 
     child("inner");
-    pt->inner->accept(*this);
+    visit(pt->inner.get());
 
     parent_id = parent;
 }
@@ -462,13 +820,23 @@ void ASTDumper::walk(ArrayType *at) {
     edge(parent, parent_id);
 
     child("inner");
-    at->inner->accept(*this);
+    visit(at->inner.get());
 
     parent_id = parent;
 }
 
 void ASTDumper::walk(BaseType *bt) {
-    edge(parent_id, node(bt->str()));
+    int parent = parent_id;
+
+    parent_id = node(bt->name);
+    edge(parent, parent_id);
+
+    for (auto& temp: bt->templates) {
+        child("template");
+        visit(temp.get());
+    }
+
+    parent_id = parent;
 }
 
 void ASTDumper::walk(VariableAccess *vAcc) {
@@ -478,7 +846,7 @@ void ASTDumper::walk(VariableAccess *vAcc) {
 
     for (auto& temp: vAcc->templates) {
         child("template");
-        temp->accept(*this);
+        visit(temp.get());
     }
 
     parent_id = parent;
@@ -493,7 +861,14 @@ void ASTDumper::walk(StringLiteral *sl) {
 }
 
 void ASTDumper::walk(CharLiteral *cl) {
-    edge(parent_id, node(std::string("'") + cl->value + "'"));
+    char text[] = { '\'', cl->value, '\'' };
+
+    int id = begin_node();
+    if (emitting()) {
+        label(text, sizeof(text));
+        end_node();
+    }
+    edge(parent_id, id);
 }
 
 void ASTDumper::walk(NullLiteral *nl) {
@@ -507,10 +882,10 @@ void ASTDumper::walk(IntLiteral *il) {
     edge(parent, parent_id);
 
     child("value");
-    edge(parent_id, node(std::to_string(il->value)));
+    edge(parent_id, node(il->value));
 
     child("type");
-    il->type->accept(*this);
+    visit(il->type.get());
 
     parent_id = parent;
 }
@@ -522,10 +897,18 @@ void ASTDumper::walk(FloatLiteral *fl) {
     edge(parent, parent_id);
 
     child("value");
-    edge(parent_id, node(std::to_string(fl->value)));
+    char text[64];
+    int length = snprintf(text, sizeof(text), "%Lf", fl->value);
+
+    int id = begin_node();
+    if (emitting()) {
+        label(text, length < (int) sizeof(text) ? length : sizeof(text) - 1);
+        end_node();
+    }
+    edge(parent_id, id);
 
     child("type");
-    fl->type->accept(*this);
+    visit(fl->type.get());
 
     parent_id = parent;
 }
@@ -537,10 +920,10 @@ void ASTDumper::walk(ArrayIndexing *ai) {
     edge(parent, parent_id);
 
     child("base");
-    ai->base->accept(*this);
+    visit(ai->base.get());
 
     child("index");
-    ai->index->accept(*this);
+    visit(ai->index.get());
 
     parent_id = parent;
 }
@@ -552,7 +935,7 @@ void ASTDumper::walk(FunctionCall *fCall) {
     edge(parent, parent_id);
 
     child("base");
-    fCall->base->accept(*this);
+    visit(fCall->base.get());
 
     for (auto& arg: fCall->args) {
         int loop_parent = parent_id;
@@ -566,7 +949,7 @@ void ASTDumper::walk(FunctionCall *fCall) {
         }
 
         child("expr");
-        arg.expr->accept(*this);
+        visit(arg.expr.get());
 
         parent_id = loop_parent;
     }
@@ -577,15 +960,15 @@ void ASTDumper::walk(FunctionCall *fCall) {
 void ASTDumper::walk(Sizeof *sf) {
     int parent = parent_id;
 
-    parent_id = node("sizeof");
+    parent_id = sf->value >= 0 ? node("sizeof ", std::to_string(sf->value)) : node("sizeof");
     edge(parent, parent_id);
 
     if (sf->expr) {
         child("expr");
-        sf->expr->accept(*this);
+        visit(sf->expr.get());
     } else if (sf->arg_type) {
         child("arg_type");
-        sf->arg_type->accept(*this);
+        visit(sf->arg_type.get());
     }
 
     parent_id = parent;
@@ -594,11 +977,17 @@ void ASTDumper::walk(Sizeof *sf) {
 void ASTDumper::walk(UnaryOperator *op) {
     int parent = parent_id;
 
-    parent_id = node(std::string() + op->opChar());
+    char text = op->opChar();
+
+    parent_id = begin_node();
+    if (emitting()) {
+        label(&text, 1);
+        end_node();
+    }
     edge(parent, parent_id);
 
     child("expr");
-    op->expr->accept(*this);
+    visit(op->expr.get());
 
     parent_id = parent;
 }
@@ -610,10 +999,10 @@ void ASTDumper::walk(Cast *cast) {
     edge(parent, parent_id);
 
     child("expr");
-    cast->expr->accept(*this);
+    visit(cast->expr.get());
 
     child("type");
-    cast->type->accept(*this);
+    visit(cast->type.get());
 
     parent_id = parent;
 }
@@ -625,10 +1014,10 @@ void ASTDumper::walk(BinaryOperator *op) {
     edge(parent, parent_id);
 
     child("left");
-    op->left->accept(*this);
+    visit(op->left.get());
 
     child("right");
-    op->right->accept(*this);
+    visit(op->right.get());
 
     parent_id = parent;
 }
@@ -640,13 +1029,13 @@ void ASTDumper::walk(IfExpr *ie) {
     edge(parent, parent_id);
 
     child("condition");
-    ie->condition->accept(*this);
+    visit(ie->condition.get());
 
     child("if_scope");
-    ie->ifScope->accept(*this);
+    visit(ie->ifScope.get());
 
     child("else_scope");
-    ie->elseScope->accept(*this);
+    visit(ie->elseScope.get());
 
     parent_id = parent;
 }
@@ -658,10 +1047,10 @@ void ASTDumper::walk(Assignment *ass) {
     edge(parent, parent_id);
 
     child("left");
-    ass->left->accept(*this);
+    visit(ass->left.get());
 
     child("right");
-    ass->right->accept(*this);
+    visit(ass->right.get());
 
     parent_id = parent;
 }
@@ -669,11 +1058,16 @@ void ASTDumper::walk(Assignment *ass) {
 void ASTDumper::walk(FieldAccess *fa) {
     int parent = parent_id;
 
-    parent_id = node("field_access");
+    if (fa->column >= 0) {
+        parent_id = node("field_access ", "[column " + std::to_string(fa->column) + ", stride " + std::to_string(fa->stride) + ']');
+    } else {
+        parent_id = node("field_access");
+    }
+
     edge(parent, parent_id);
 
     child("expr");
-    fa->expr->accept(*this);
+    visit(fa->expr.get());
 
     child("field_name");
     edge(parent_id, node(fa->field_name));
@@ -688,14 +1082,14 @@ void ASTDumper::walk(IsExpr *is) {
     edge(parent, parent_id);
 
     child("base");
-    is->base->accept(*this);
+    visit(is->base.get());
 
     child("tag");
     edge(parent_id, node(is->tag));
 
     for (auto& expr: is->exprs) {
         child("expr");
-        expr->accept(*this);
+        visit(expr.get());
     }
 
     parent_id = parent;
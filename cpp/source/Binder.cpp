@@ -0,0 +1,865 @@
+#include <Binder.hpp>
+#include <Parser.hpp>
+
+#include <cstring>
+#include <type_traits>
+
+// Bump allocator of zeroed, trivial objects, freed all at once
+struct Binder::Arena {
+    static const size_t block_size = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *next = nullptr;
+    size_t left = 0;
+
+    template <typename T>
+    T *make(size_t count = 1) {
+        static_assert(std::is_trivial<T>::value && alignof(T) <= 8, "Arena objects are zeroed memory");
+
+        size_t bytes = (count * sizeof(T) + 7) & ~static_cast<size_t>(7);
+
+        if (bytes > left) {
+            size_t size = bytes > block_size ? bytes : block_size;
+            blocks.emplace_back(new char[size]);
+            next = blocks.back().get();
+            left = size;
+        }
+
+        char *at = next;
+        next += bytes;
+        left -= bytes;
+
+        memset(at, 0, bytes);
+        return reinterpret_cast<T*>(at);
+    }
+};
+
+// Id to declaration, by linear probing. The slots are made by the first add().
+struct Binder::Table {
+    Table *parent;
+
+    // What using statements of the scope brought in, looked up after the scope's own declarations
+    Using *used;
+
+    uint32_t *ids;
+    Declaration **decls;
+
+    // 1 << bits slots, bits is 0 until there are slots
+    uint32_t bits;
+    uint32_t size;
+};
+
+// What a using statement brought in: the table of a declaration of the unit, or the members of an imported namespace
+struct Binder::Using {
+    Table *table;
+    const Exports *exports;
+    Using *next;
+};
+
+// A name looked up, its id is 0 when no declaration has it
+struct Binder::Name {
+    const std::string& text;
+    uint64_t hash;
+    uint32_t id;
+};
+
+static bool declaration(Node *node) {
+    switch (node->kind) {
+        case Node::Kind::NamespaceDecl:
+        case Node::Kind::FuncDecl:
+        case Node::Kind::TemplateDecl:
+        case Node::Kind::StructDecl:
+        case Node::Kind::VariableDecl:
+        case Node::Kind::AliasDecl:
+        case Node::Kind::VariantDecl:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool type_declaration(Declaration *decl) {
+    switch (decl->kind) {
+        case Node::Kind::StructDecl:
+        case Node::Kind::AliasDecl:
+        case Node::Kind::VariantDecl:
+        case Node::Kind::TemplateDecl:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Fibonacci hashing, the top bits of the product are the best mixed
+static uint32_t slot(uint32_t id, uint32_t bits) {
+    return (id * 2654435769u) >> (32 - bits);
+}
+
+Binder::Binder(Names& _names) : arena(new Arena()), names(_names), current(nullptr), bodies(true) {}
+
+Binder::~Binder() {}
+
+void Binder::import(const Exports *exports) {
+    imported.push_back(exports);
+}
+
+// a::b::c into a, b and c
+static std::vector<std::string> split(const std::string& name) {
+    std::vector<std::string> segments;
+
+    for (size_t begin = 0; begin <= name.size(); ) {
+        size_t end = name.find("::", begin);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+
+        segments.push_back(name.substr(begin, end - begin));
+        begin = end + 2;
+    }
+
+    return segments;
+}
+
+// What the binder knows of name, asking names the first time.
+// An id of 0 stays right for the binder until it interns the name itself: only its own declarations are in its tables.
+Binder::Known& Binder::known(const std::string& name, uint64_t hash) {
+    // Kept under half full
+    if ((known_names.size() + 1) * 2 > known_slots.size()) {
+        std::vector<uint32_t> slots(known_slots.empty() ? 64 : known_slots.size() * 2, 0);
+        known_slots.swap(slots);
+
+        size_t mask = known_slots.size() - 1;
+        for (size_t i = 0; i < known_names.size(); ++i) {
+            size_t at = known_names[i].hash & mask;
+            while (known_slots[at]) {
+                at = (at + 1) & mask;
+            }
+
+            known_slots[at] = i + 1;
+        }
+    }
+
+    size_t mask = known_slots.size() - 1;
+    size_t at = hash & mask;
+
+    for (; known_slots[at]; at = (at + 1) & mask) {
+        Known& entry = known_names[known_slots[at] - 1];
+
+        if (entry.hash == hash && entry.text == name) {
+            return entry;
+        }
+    }
+
+    known_names.push_back({ name, hash, names.find(name, hash) });
+    known_slots[at] = known_names.size();
+
+    return known_names.back();
+}
+
+uint32_t Binder::intern(const std::string& name) {
+    Known& entry = known(name, Exports::name_hash(name));
+
+    if (!entry.id) {
+        entry.id = names.intern(name, entry.hash);
+    }
+
+    return entry.id;
+}
+
+// 0 for a name no declaration has
+uint32_t Binder::symbol(const std::string& name, uint64_t hash) {
+    return known(name, hash).id;
+}
+
+// A scope in parent with room for expected declarations before it grows
+Binder::Table *Binder::table(Table *parent, size_t expected) {
+    Table *made = arena->make<Table>();
+    made->parent = parent;
+
+    if (expected > 0) {
+        uint32_t bits = 3;
+        while ((static_cast<size_t>(1) << bits) * 3 < expected * 4) {
+            bits++;
+        }
+
+        made->bits = bits;
+        made->ids = arena->make<uint32_t>(static_cast<size_t>(1) << bits);
+        made->decls = arena->make<Declaration*>(static_cast<size_t>(1) << bits);
+    }
+
+    return made;
+}
+
+// A later declaration of a name hides an earlier one, but a namespace declared again adds to the first
+void Binder::add(Table *table, Declaration *decl) {
+    std::string name = declaration_name(decl);
+    if (name.empty()) {
+        return;
+    }
+
+    uint32_t id = intern(name);
+
+    // Kept under three quarters full
+    if (!table->bits || (table->size + 1) * 4 > (static_cast<size_t>(1) << table->bits) * 3) {
+        uint32_t bits = table->bits ? table->bits + 1 : 3;
+        uint32_t *ids = arena->make<uint32_t>(static_cast<size_t>(1) << bits);
+        Declaration **decls = arena->make<Declaration*>(static_cast<size_t>(1) << bits);
+
+        for (size_t i = 0; table->bits && i < (static_cast<size_t>(1) << table->bits); ++i) {
+            if (table->ids[i]) {
+                uint32_t at = slot(table->ids[i], bits);
+                while (ids[at]) {
+                    at = (at + 1) & ((1u << bits) - 1);
+                }
+
+                ids[at] = table->ids[i];
+                decls[at] = table->decls[i];
+            }
+        }
+
+        table->ids = ids;
+        table->decls = decls;
+        table->bits = bits;
+    }
+
+    uint32_t mask = (1u << table->bits) - 1;
+    uint32_t at = slot(id, table->bits);
+
+    while (table->ids[at] && table->ids[at] != id) {
+        at = (at + 1) & mask;
+    }
+
+    if (!table->ids[at]) {
+        table->ids[at] = id;
+        table->decls[at] = decl;
+        table->size++;
+        return;
+    }
+
+    Declaration *earlier = table->decls[at];
+
+    if (earlier->kind == Node::Kind::NamespaceDecl && decl->kind == Node::Kind::NamespaceDecl) {
+        reopened[earlier].push_back(decl);
+        first_of[decl] = earlier;
+        return;
+    }
+
+    table->decls[at] = decl;
+}
+
+// The declaration of name in table alone or what its using statements brought in, nullptr when there is none.
+// frozen is set to its entry when it is a member of an imported namespace, to nullptr otherwise.
+Declaration *Binder::get(Table *table, const Name& name, const Exports::Entry **frozen) const {
+    if (name.id && table->bits) {
+        uint32_t mask = (1u << table->bits) - 1;
+
+        for (uint32_t at = slot(name.id, table->bits); table->ids[at]; at = (at + 1) & mask) {
+            if (table->ids[at] == name.id) {
+                *frozen = nullptr;
+                return table->decls[at];
+            }
+        }
+    }
+
+    for (Using *used = table->used; used; used = used->next) {
+        if (used->table) {
+            if (Declaration *decl = get(used->table, name, frozen)) {
+                return decl;
+            }
+        } else if (const Exports::Entry *entry = used->exports->find(name.text, name.hash)) {
+            *frozen = entry;
+            return entry->decl;
+        }
+    }
+
+    return nullptr;
+}
+
+// Table of the members of a namespace, struct or variant, nullptr for other declarations.
+// Its parent is set by whoever walks into it.
+Binder::Table *Binder::members(Declaration *decl) {
+    auto first = first_of.find(decl);
+    if (first != first_of.end()) {
+        decl = first->second;
+    }
+
+    auto found = member_tables.find(decl);
+    if (found != member_tables.end()) {
+        return found->second;
+    }
+
+    Table *made = nullptr;
+
+    switch (decl->kind) {
+        case Node::Kind::NamespaceDecl: {
+            auto ns = static_cast<NamespaceDeclaration*>(decl);
+            auto again = reopened.find(decl);
+
+            made = table(nullptr, ns->decls.size());
+
+            for (auto& member: ns->decls) {
+                add(made, member.get());
+            }
+
+            if (again != reopened.end()) {
+                for (Declaration *other: again->second) {
+                    for (auto& member: static_cast<NamespaceDeclaration*>(other)->decls) {
+                        add(made, member.get());
+                    }
+                }
+            }
+
+            break;
+        }
+        case Node::Kind::StructDecl: {
+            auto sDecl = static_cast<StructDeclaration*>(decl);
+            made = table(nullptr, sDecl->templates.size() + sDecl->subdecls.size());
+
+            for (auto& temp: sDecl->templates) {
+                add(made, &temp);
+            }
+
+            for (auto& sub: sDecl->subdecls) {
+                add(made, sub.get());
+            }
+
+            break;
+        }
+        case Node::Kind::VariantDecl: {
+            auto vDecl = static_cast<VariantDeclaration*>(decl);
+            made = table(nullptr, vDecl->templates.size() + vDecl->subdecls.size());
+
+            for (auto& temp: vDecl->templates) {
+                add(made, &temp);
+            }
+
+            for (auto& sub: vDecl->subdecls) {
+                add(made, sub.get());
+            }
+
+            break;
+        }
+        default:
+            break;
+    }
+
+    member_tables[decl] = made;
+    return made;
+}
+
+// Innermost declaration name means from the current scope, a type declaration for a type.
+// frozen is set to its entry when it is exported by an imported unit, to nullptr otherwise.
+Declaration *Binder::lookup(const std::string& name, bool type, const Exports::Entry **frozen) {
+    const Exports::Entry *entry = nullptr;
+    if (!frozen) {
+        frozen = &entry;
+    }
+
+    *frozen = nullptr;
+
+    if (name.find(':') == std::string::npos) {
+        uint64_t hash = Exports::name_hash(name);
+        Name key { name, hash, symbol(name, hash) };
+
+        for (Table *scope = current; scope; scope = scope->parent) {
+            Declaration *decl = get(scope, key, frozen);
+
+            if (decl && (!type || type_declaration(decl))) {
+                return decl;
+            }
+        }
+
+        for (auto exports = imported.rbegin(); exports != imported.rend(); ++exports) {
+            const Exports::Entry *found = (*exports)->find(name, hash);
+
+            if (found && (!type || type_declaration(found->decl))) {
+                *frozen = found;
+                return found->decl;
+            }
+        }
+
+        *frozen = nullptr;
+        return nullptr;
+    }
+
+    std::vector<std::string> segments = split(name);
+
+    for (Table *scope = current; scope; scope = scope->parent) {
+        if (Declaration *decl = qualified(scope, segments, 0, type, frozen)) {
+            return decl;
+        }
+    }
+
+    for (auto exports = imported.rbegin(); exports != imported.rend(); ++exports) {
+        if (Declaration *decl = qualified(*exports, segments, 0, type, frozen)) {
+            return decl;
+        }
+    }
+
+    *frozen = nullptr;
+    return nullptr;
+}
+
+// segments[from] on in table alone. A namespace may be named by several segments (namespace a::b), all the ways to split them are tried.
+Declaration *Binder::qualified(Table *table, const std::vector<std::string>& segments, size_t from, bool type, const Exports::Entry **frozen) {
+    std::string prefix;
+
+    for (size_t end = from; end < segments.size(); ++end) {
+        prefix += end > from ? "::" + segments[end] : segments[end];
+
+        uint64_t hash = Exports::name_hash(prefix);
+        Name key { prefix, hash, symbol(prefix, hash) };
+
+        const Exports::Entry *entry = nullptr;
+        Declaration *decl = get(table, key, &entry);
+
+        if (!decl) {
+            continue;
+        }
+
+        if (end + 1 == segments.size()) {
+            if (!type || type_declaration(decl)) {
+                *frozen = entry;
+                return decl;
+            }
+
+            continue;
+        }
+
+        if (entry && entry->members) {
+            if (Declaration *found = qualified(entry->members.get(), segments, end + 1, type, frozen)) {
+                return found;
+            }
+        } else if (Table *inner = members(decl)) {
+            if (Declaration *found = qualified(inner, segments, end + 1, type, frozen)) {
+                return found;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+// The same in what an imported unit or namespace exports, each segment is one probe
+Declaration *Binder::qualified(const Exports *exports, const std::vector<std::string>& segments, size_t from, bool type, const Exports::Entry **frozen) {
+    std::string prefix;
+
+    for (size_t end = from; end < segments.size(); ++end) {
+        prefix += end > from ? "::" + segments[end] : segments[end];
+
+        const Exports::Entry *entry = exports->find(prefix, Exports::name_hash(prefix));
+
+        if (!entry) {
+            continue;
+        }
+
+        if (end + 1 == segments.size()) {
+            if (!type || type_declaration(entry->decl)) {
+                *frozen = entry;
+                return entry->decl;
+            }
+
+            continue;
+        }
+
+        // The members of imported structs and variants are not frozen, they get a table like those of the unit
+        if (entry->members) {
+            if (Declaration *found = qualified(entry->members.get(), segments, end + 1, type, frozen)) {
+                return found;
+            }
+        } else if (Table *inner = members(entry->decl)) {
+            if (Declaration *found = qualified(inner, segments, end + 1, type, frozen)) {
+                return found;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+void Binder::visit(Node *node) {
+    if (node) {
+        node->accept(*this);
+    }
+}
+
+// Statements of a block in the current scope, their declarations are seen from the next statement on.
+// Functions and types are seen in themselves, so they may be recursive.
+void Binder::statements(std::vector<std::unique_ptr<Statement>>& list) {
+    for (auto& stmt: list) {
+        bool variable = stmt->kind == Node::Kind::VariableDecl;
+
+        if (declaration(stmt.get()) && !variable) {
+            add(current, static_cast<Declaration*>(stmt.get()));
+        }
+
+        stmt->accept(*this);
+
+        if (variable) {
+            add(current, static_cast<Declaration*>(stmt.get()));
+        }
+    }
+}
+
+void Binder::bind(Unit *unit) {
+    visit(unit);
+}
+
+void Binder::signatures(const std::vector<Declaration*>& decls) {
+    bodies = false;
+    top(decls);
+    bodies = true;
+}
+
+// Top-level declarations see each other whatever their order
+void Binder::top(const std::vector<Declaration*>& decls) {
+    current = table(nullptr, decls.size());
+    for (Declaration *decl: decls) {
+        add(current, decl);
+    }
+
+    for (Declaration *decl: decls) {
+        visit(decl);
+    }
+
+    current = nullptr;
+}
+
+void Binder::walk(Unit *u) {
+    std::vector<Declaration*> decls;
+    for (auto& decl: u->decls) {
+        decls.push_back(decl.get());
+    }
+
+    top(decls);
+}
+
+void Binder::walk(Use *u) {}
+
+void Binder::walk(Import *i) {}
+
+void Binder::walk(TemplateDeclaration *decl) {}
+
+void Binder::walk(NamespaceDeclaration *decl) {
+    Table *outer = current;
+
+    current = members(decl);
+    current->parent = outer;
+
+    for (auto& member: decl->decls) {
+        visit(member.get());
+    }
+
+    current = outer;
+}
+
+void Binder::walk(VariableDeclaration *decl) {
+    visit(decl->type.get());
+
+    if (bodies) {
+        visit(decl->init_expr.get());
+    }
+}
+
+void Binder::walk(FunctionDeclaration *decl) {
+    Table *outer = current;
+    current = table(outer, decl->templates.size() + decl->arglist.size());
+
+    for (auto& temp: decl->templates) {
+        add(current, &temp);
+    }
+
+    for (auto& arg: decl->arglist) {
+        visit(arg.get());
+        add(current, arg.get());
+    }
+
+    visit(decl->return_type.get());
+
+    if (bodies) {
+        visit(Parser::body(decl));
+    }
+
+    current = outer;
+}
+
+void Binder::walk(StructDeclaration *decl) {
+    Table *outer = current;
+
+    current = members(decl);
+    current->parent = outer;
+
+    for (auto& field: decl->fields) {
+        visit(field.get());
+    }
+
+    for (auto& sub: decl->subdecls) {
+        visit(sub.get());
+    }
+
+    current = outer;
+}
+
+void Binder::walk(AliasDeclaration *decl) {
+    Table *outer = current;
+    current = table(outer, decl->templates.size());
+
+    for (auto& temp: decl->templates) {
+        add(current, &temp);
+    }
+
+    visit(decl->from_type.get());
+
+    current = outer;
+}
+
+void Binder::walk(VariantDeclaration *decl) {
+    Table *outer = current;
+
+    current = members(decl);
+    current->parent = outer;
+
+    visit(decl->from_type.get());
+
+    for (auto& field: decl->fields) {
+        visit(field.type.get());
+    }
+
+    for (auto& sub: decl->subdecls) {
+        visit(sub.get());
+    }
+
+    current = outer;
+}
+
+void Binder::walk(SyntaxError *error) {}
+
+void Binder::walk(BaseType *type) {
+    type->ref = static_cast<TypeDeclaration*>(lookup(type->name, true));
+
+    for (auto& temp: type->templates) {
+        visit(temp.get());
+    }
+}
+
+void Binder::walk(PointerType *type) {
+    visit(type->inner.get());
+}
+
+void Binder::walk(ArrayType *type) {
+    visit(type->inner.get());
+}
+
+void Binder::walk(FunctionType *type) {
+    for (auto& arg: type->argTypes) {
+        visit(arg.get());
+    }
+
+    visit(type->returnType.get());
+}
+
+void Binder::walk(ClosureType *type) {
+    for (auto& arg: type->argTypes) {
+        visit(arg.get());
+    }
+
+    visit(type->returnType.get());
+}
+
+void Binder::walk(TupleType *type) {
+    for (auto& inner: type->types) {
+        visit(inner.get());
+    }
+}
+
+void Binder::walk(Scope *scope) {
+    Table *outer = current;
+    current = table(outer, 0);
+
+    statements(scope->statements);
+
+    current = outer;
+}
+
+void Binder::walk(IfStmt *ifS) {
+    visit(ifS->condition.get());
+    visit(ifS->ifStmt.get());
+    visit(ifS->elseStmt.get());
+}
+
+void Binder::walk(WhileStmt *wS) {
+    visit(wS->condition.get());
+    visit(wS->body.get());
+}
+
+// The declarations of the init scope are seen by the rest of the loop
+void Binder::walk(ForStmt *fS) {
+    Table *outer = current;
+    current = table(outer, 0);
+
+    if (fS->initScope) {
+        statements(fS->initScope->statements);
+    }
+
+    visit(fS->condition.get());
+    visit(fS->loopExpr.get());
+    visit(fS->body.get());
+
+    current = outer;
+}
+
+void Binder::walk(ReturnStmt *ret) {
+    visit(ret->expr.get());
+}
+
+// The members of what is named are seen in the scope given, or in the rest of the current one.
+// A namespace several imported units export is the members of all of them, those of the last import first.
+void Binder::walk(UsingStmt *us) {
+    const Exports::Entry *frozen = nullptr;
+    Declaration *decl = lookup(us->name, false, &frozen);
+
+    Table *used = decl && !(frozen && frozen->members) ? members(decl) : nullptr;
+    std::vector<const Exports*> exported;
+
+    if (frozen && frozen->members) {
+        std::vector<std::string> segments = split(us->name);
+        bool imported_name = false;
+
+        for (const Exports *exports: imported) {
+            const Exports::Entry *other = nullptr;
+
+            if (qualified(exports, segments, 0, false, &other) && other && other->members) {
+                exported.push_back(other->members.get());
+                imported_name = imported_name || other == frozen;
+            }
+        }
+
+        // Found in the members of a namespace an enclosing using statement brought in
+        if (!imported_name) {
+            exported.assign(1, frozen->members.get());
+        }
+    }
+
+    Table *outer = current;
+    if (us->scope) {
+        current = table(outer, 0);
+    }
+
+    if (used) {
+        Using *link = arena->make<Using>();
+        link->table = used;
+        link->next = current->used;
+        current->used = link;
+    }
+
+    for (const Exports *exports: exported) {
+        Using *link = arena->make<Using>();
+        link->exports = exports;
+        link->next = current->used;
+        current->used = link;
+    }
+
+    if (us->scope) {
+        visit(us->scope.get());
+        current = outer;
+    }
+}
+
+void Binder::walk(DeferStmt *defer) {
+    visit(defer->scope.get());
+}
+
+void Binder::walk(MatchStmt *match) {
+    visit(match->matched_expr.get());
+
+    for (auto& c: match->cases) {
+        visit(c.expr.get());
+
+        for (auto& expr: c.exprs) {
+            visit(expr.get());
+        }
+
+        visit(c.body.get());
+    }
+
+    visit(match->else_scope.get());
+}
+
+void Binder::walk(BreakStmt *bs) {}
+
+void Binder::walk(ContinueStmt *cs) {}
+
+void Binder::walk(VariableAccess *vAcc) {
+    vAcc->ref = lookup(vAcc->name, false);
+
+    for (auto& temp: vAcc->templates) {
+        visit(temp.get());
+    }
+}
+
+void Binder::walk(FieldAccess *fAcc) {
+    visit(fAcc->expr.get());
+}
+
+void Binder::walk(BoolLiteral *lit) {}
+
+void Binder::walk(StringLiteral *lit) {}
+
+void Binder::walk(CharLiteral *lit) {}
+
+void Binder::walk(IntLiteral *lit) {}
+
+void Binder::walk(NullLiteral *lit) {}
+
+void Binder::walk(FloatLiteral *lit) {}
+
+void Binder::walk(ArrayIndexing *ai) {
+    visit(ai->base.get());
+    visit(ai->index.get());
+}
+
+void Binder::walk(FunctionCall *call) {
+    visit(call->base.get());
+
+    for (auto& arg: call->args) {
+        visit(arg.expr.get());
+    }
+}
+
+void Binder::walk(Sizeof *sof) {
+    visit(sof->expr.get());
+    visit(sof->arg_type.get());
+}
+
+void Binder::walk(UnaryOperator *op) {
+    visit(op->expr.get());
+}
+
+void Binder::walk(Cast *cast) {
+    visit(cast->expr.get());
+    visit(cast->type.get());
+}
+
+void Binder::walk(IsExpr *is) {
+    visit(is->base.get());
+
+    for (auto& expr: is->exprs) {
+        visit(expr.get());
+    }
+}
+
+void Binder::walk(BinaryOperator *op) {
+    visit(op->left.get());
+    visit(op->right.get());
+}
+
+void Binder::walk(Assignment *ass) {
+    visit(ass->left.get());
+    visit(ass->right.get());
+}
+
+void Binder::walk(IfExpr *ifExpr) {
+    visit(ifExpr->condition.get());
+    visit(ifExpr->ifScope.get());
+    visit(ifExpr->elseScope.get());
+}
@@ -0,0 +1,51 @@
+#include <BufferedWriter.hpp>
+
+void BufferedWriter::write(const char *data, size_t length) {
+    if (used + length > capacity) {
+        flush();
+
+        // Too big to be worth buffering
+        if (length > capacity) {
+            fwrite(data, 1, length, file);
+            return;
+        }
+    }
+
+    memcpy(buffer + used, data, length);
+    used += length;
+}
+
+void BufferedWriter::write_int(int64_t value) {
+    // 20 digits and a sign
+    char digits[21];
+    int pos = sizeof(digits);
+
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+
+    do {
+        digits[--pos] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+
+    if (value < 0) {
+        digits[--pos] = '-';
+    }
+
+    write(digits + pos, sizeof(digits) - pos);
+}
+
+void BufferedWriter::write_varint(uint64_t value) {
+    while (value >= 0x80) {
+        write(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+
+    write(static_cast<char>(value));
+}
+
+void BufferedWriter::flush() {
+    if (used) {
+        fwrite(buffer, 1, used, file);
+        used = 0;
+    }
+}
@@ -0,0 +1,217 @@
+#include <Bundle.hpp>
+#include <Files.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t bundle_version = 1;
+static const uint32_t byte_order_mark = 0x01020304;
+
+enum HeaderWord {
+    header_magic, header_version, header_byte_order, header_entries,
+    header_words
+};
+
+enum IndexWord {
+    index_name, index_name_length, index_data, index_data_length,
+    index_words
+};
+
+static void pad(std::string& bytes, size_t alignment) {
+    bytes.resize((bytes.size() + alignment - 1) / alignment * alignment, '\0');
+}
+
+bool Bundle::write(std::vector<std::pair<std::string, std::string>> entries, const std::string& path) {
+    std::sort(entries.begin(), entries.end());
+
+    size_t index_at = header_words * sizeof(uint32_t);
+    size_t names_at = index_at + entries.size() * index_words * sizeof(uint32_t);
+
+    std::vector<uint32_t> words(header_words + entries.size() * index_words);
+    memcpy(&words[header_magic], "SKYB", 4);
+    words[header_version] = bundle_version;
+    words[header_byte_order] = byte_order_mark;
+    words[header_entries] = entries.size();
+
+    std::string names, data;
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        uint32_t *index = &words[header_words + i * index_words];
+
+        index[index_name] = names_at + names.size();
+        index[index_name_length] = entries[i].first.size();
+        names += entries[i].first;
+    }
+
+    pad(names, 8);
+    size_t data_at = names_at + names.size();
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        uint32_t *index = &words[header_words + i * index_words];
+        std::string contents;
+
+        if (!read_file(entries[i].second, contents)) {
+            return false;
+        }
+
+        index[index_data] = data_at + data.size();
+        index[index_data_length] = contents.size();
+
+        data += contents;
+        pad(data, 8);
+    }
+
+    // Written aside then renamed, builds never see half a file
+    std::string temp = temporary_path(path);
+    FILE *file = fopen(temp.c_str(), "wb");
+
+    if (!file) {
+        return false;
+    }
+
+    bool ok = fwrite(words.data(), sizeof(uint32_t), words.size(), file) == words.size();
+    ok = ok && fwrite(names.data(), 1, names.size(), file) == names.size();
+    ok = ok && fwrite(data.data(), 1, data.size(), file) == data.size();
+    ok = fclose(file) == 0 && ok;
+
+    if (ok && std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(path.c_str());
+        ok = std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+
+    if (!ok) {
+        std::remove(temp.c_str());
+    }
+
+    return ok;
+}
+
+std::unique_ptr<Bundle> Bundle::open(const std::string& path) {
+    std::unique_ptr<Bundle> bundle(new Bundle());
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(header_words * sizeof(uint32_t))) {
+        close(fd);
+        return nullptr;
+    }
+
+    void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        return nullptr;
+    }
+
+    bundle->mapping = mapped;
+    bundle->mapping_size = info.st_size;
+    bundle->words = static_cast<const uint32_t*>(mapped);
+    bundle->bytes = info.st_size;
+#else
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return nullptr;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // Words of 8 bytes keep the contents aligned as they are in the file
+    bundle->copy.resize(length > 0 ? (length + 7) / 8 : 0);
+    size_t read = fread(bundle->copy.data(), 1, length > 0 ? length : 0, file);
+    fclose(file);
+
+    if (length < 0 || read != static_cast<size_t>(length) || read < header_words * sizeof(uint32_t)) {
+        return nullptr;
+    }
+
+    bundle->words = reinterpret_cast<const uint32_t*>(bundle->copy.data());
+    bundle->bytes = read;
+#endif
+
+    const uint32_t *words = bundle->words;
+
+    if (memcmp(&words[header_magic], "SKYB", 4) != 0 || words[header_version] != bundle_version || words[header_byte_order] != byte_order_mark) {
+        return nullptr;
+    }
+
+    size_t entries = words[header_entries];
+    size_t bytes = bundle->bytes;
+
+    if (entries > (bytes / sizeof(uint32_t) - header_words) / index_words) {
+        return nullptr;
+    }
+
+    // Checked once here, lookups trust the index
+    for (size_t i = 0; i < entries; ++i) {
+        const uint32_t *index = &words[header_words + i * index_words];
+
+        if (index[index_name] > bytes || index[index_name_length] > bytes - index[index_name]
+            || index[index_data] > bytes || index[index_data_length] > bytes - index[index_data] || index[index_data] % 8 != 0) {
+            return nullptr;
+        }
+    }
+
+    bundle->entries = entries;
+    return bundle;
+}
+
+Bundle::~Bundle() {
+#ifndef _WIN32
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+#endif
+}
+
+size_t Bundle::find(const std::string& name) const {
+    const char *base = reinterpret_cast<const char*>(words);
+    size_t low = 0, high = entries;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        const uint32_t *index = &words[header_words + middle * index_words];
+
+        const char *other = base + index[index_name];
+        size_t length = index[index_name_length];
+
+        int order = memcmp(other, name.data(), std::min(length, name.size()));
+        if (order == 0) {
+            order = length < name.size() ? -1 : length > name.size() ? 1 : 0;
+        }
+
+        if (order == 0) {
+            return middle;
+        }
+
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return none;
+}
+
+const char *Bundle::data(size_t i) const {
+    return reinterpret_cast<const char*>(words) + words[header_words + i * index_words + index_data];
+}
+
+size_t Bundle::length(size_t i) const {
+    return words[header_words + i * index_words + index_data_length];
+}
@@ -0,0 +1,87 @@
+#include <Cache.hpp>
+#include <Files.hpp>
+
+#include <cstdio>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+static void make_directory(const std::string& path) {
+#ifndef _WIN32
+    mkdir(path.c_str(), 0777);
+#else
+    _mkdir(path.c_str());
+#endif
+}
+
+// Copies from into to aside, then renames it over to
+static bool copy(const std::string& from, const std::string& to, const std::string& aside) {
+    FILE *in = fopen(from.c_str(), "rb");
+    if (!in) {
+        return false;
+    }
+
+    FILE *out = fopen(aside.c_str(), "wb");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+
+    char buffer[1 << 16];
+    size_t read;
+    bool ok = true;
+
+    while (ok && (read = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        ok = fwrite(buffer, 1, read, out) == read;
+    }
+
+    ok = !ferror(in) && ok;
+    fclose(in);
+    ok = fclose(out) == 0 && ok;
+
+    if (ok && std::rename(aside.c_str(), to.c_str()) != 0) {
+        // Windows does not rename over an existing file
+        std::remove(to.c_str());
+        ok = std::rename(aside.c_str(), to.c_str()) == 0;
+    }
+
+    if (!ok) {
+        std::remove(aside.c_str());
+    }
+
+    return ok;
+}
+
+std::string Cache::path(uint64_t key, const std::string& kind) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%02x/%014llx.", static_cast<unsigned>(key >> 56), static_cast<unsigned long long>(key & 0xFFFFFFFFFFFFFFULL));
+
+    return directory + '/' + name + kind;
+}
+
+bool Cache::has(uint64_t key, const std::string& kind) const {
+    struct stat info;
+    return stat(path(key, kind).c_str(), &info) == 0;
+}
+
+std::string Cache::scratch() {
+    make_directory(directory);
+    return temporary_path(directory + "/scratch");
+}
+
+bool Cache::store(uint64_t key, const std::string& kind, const std::string& file) {
+    std::string entry = path(key, kind);
+
+    // Made the first time an entry goes in them, whoever makes them
+    make_directory(directory);
+    make_directory(entry.substr(0, entry.rfind('/')));
+
+    return copy(file, entry, temporary_path(entry));
+}
+
+bool Cache::fetch(uint64_t key, const std::string& kind, const std::string& file) {
+    return copy(path(key, kind), file, temporary_path(file));
+}
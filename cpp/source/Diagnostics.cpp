@@ -0,0 +1,168 @@
+#include <Diagnostics.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+Diagnostics::Diagnostics(size_t _max_errors) : used(0), error_count(0), warning_count(0), dropped(0), max_errors(_max_errors) {
+    for (auto& chunk: chunks) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+Diagnostics::~Diagnostics() {
+    for (auto& chunk: chunks) {
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
+}
+
+// Counts the report and returns the slot to record it in, nullptr if it is not kept
+Diagnostics::Record *Diagnostics::claim(ErrorLevel level) {
+    if (level == ErrorLevel::Error) {
+        if (error_count++ >= max_errors && max_errors) {
+            dropped++;
+            return nullptr;
+        }
+    } else {
+        warning_count++;
+    }
+
+    size_t i = used++;
+    if (i >= chunk_size * max_chunks) {
+        dropped++;
+        return nullptr;
+    }
+
+    // The first thread to need a chunk installs it, the others free theirs
+    std::atomic<Record*>& slot = chunks[i / chunk_size];
+    Record *chunk = slot.load(std::memory_order_acquire);
+
+    if (!chunk) {
+        Record *fresh = new Record[chunk_size];
+
+        if (slot.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)) {
+            chunk = fresh;
+        } else {
+            delete[] fresh;
+        }
+    }
+
+    return &chunk[i % chunk_size];
+}
+
+void Diagnostics::report(const std::string& message, ErrorLevel level) {
+    Record *record = claim(level);
+    if (!record) {
+        return;
+    }
+
+    record->level = level;
+    record->unit = nullptr;
+    record->token = Token::empty;
+    record->message = nullptr;
+    record->text = message;
+    record->rendered.clear();
+    record->path.clear();
+}
+
+void Diagnostics::report(Unit *unit, const Token& token, const std::string& message, ErrorLevel level) {
+    Record *record = claim(level);
+    if (!record) {
+        return;
+    }
+
+    record->level = level;
+    record->unit = unit;
+    record->token = token;
+    record->message = nullptr;
+    record->text = message;
+    record->rendered.clear();
+    record->path.clear();
+}
+
+void Diagnostics::report(Unit *unit, const Token& token, const char *message, ErrorLevel level) {
+    Record *record = claim(level);
+    if (!record) {
+        return;
+    }
+
+    record->level = level;
+    record->unit = unit;
+    record->token = token;
+    record->message = message;
+    record->text.clear();
+    record->rendered.clear();
+    record->path.clear();
+}
+
+void Diagnostics::detach(Unit *unit) {
+    size_t count = std::min(used.load(), chunk_size * max_chunks);
+
+    for (size_t i = 0; i < count; ++i) {
+        Record& record = chunks[i / chunk_size].load()[i % chunk_size];
+
+        if (record.unit == unit) {
+            record.rendered = render_report(unit, record.token, record.str(), record.level);
+            record.path = unit->unit_path;
+            record.unit = nullptr;
+        }
+    }
+}
+
+void Diagnostics::flush(std::ostream& out) {
+    size_t count = std::min(used.load(), chunk_size * max_chunks);
+
+    std::vector<Record*> records;
+    records.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        records.push_back(&chunks[i / chunk_size].load()[i % chunk_size]);
+    }
+
+    auto path = [](const Record *record) -> const std::string& {
+        return record->unit ? record->unit->unit_path : record->path;
+    };
+
+    // Reports without a location have an empty path and come first, in the order they were made
+    std::stable_sort(records.begin(), records.end(), [&](const Record *a, const Record *b) {
+        int order = path(a).compare(path(b));
+        if (order != 0) {
+            return order < 0;
+        }
+
+        if (a->token.line != b->token.line) {
+            return a->token.line < b->token.line;
+        }
+
+        return a->token.column < b->token.column;
+    });
+
+    const Record *previous = nullptr;
+
+    for (const Record *record: records) {
+        // The parser backtracks, the same error can be reported twice
+        if (previous && previous->level == record->level && previous->token.line == record->token.line &&
+            previous->token.column == record->token.column && path(previous) == path(record) && !strcmp(previous->str(), record->str())) {
+            continue;
+        }
+
+        previous = record;
+
+        if (record->unit) {
+            out << render_report(record->unit, record->token, record->str(), record->level) << '\n';
+        } else if (!record->rendered.empty()) {
+            out << record->rendered << '\n';
+        } else {
+            out << record->str() << '\n';
+        }
+    }
+
+    if (dropped) {
+        out << dropped << " more report(s) not shown." << '\n';
+    }
+
+    out.flush();
+
+    used = 0;
+    dropped = 0;
+}
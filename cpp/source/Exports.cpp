@@ -0,0 +1,244 @@
+#include <Exports.hpp>
+#include <Interface.hpp>
+
+#include <algorithm>
+
+// Far more than buckets of hashes spread as Interface::hash spreads names ever take
+static const uint32_t max_seed = 1 << 20;
+
+uint64_t Exports::name_hash(const std::string& name) {
+    return Interface::hash(Interface::hash_basis, name.data(), name.size());
+}
+
+Exports::Exports(const std::vector<Declaration*>& decls, Hash hash_of) {
+    std::vector<Entry> named;
+    named.reserve(decls.size());
+
+    // Entry + 1 of each name by its hash, open addressing kept under half full
+    size_t mask = 15;
+    while (mask + 1 < decls.size() * 2) {
+        mask = mask * 2 + 1;
+    }
+
+    std::vector<uint32_t> index(mask + 1, 0);
+
+    // Members of the namespaces, by entry
+    std::vector<std::vector<Declaration*>> inner;
+
+    for (Declaration *decl: decls) {
+        std::string name = declaration_name(decl);
+        if (name.empty()) {
+            continue;
+        }
+
+        uint64_t hash = hash_of(name);
+        size_t at = hash & mask;
+
+        while (index[at] && (named[index[at] - 1].hash != hash || named[index[at] - 1].name != name)) {
+            at = (at + 1) & mask;
+        }
+
+        size_t i;
+
+        if (!index[at]) {
+            i = named.size();
+            index[at] = i + 1;
+
+            named.push_back({ std::move(name), hash, decl, nullptr });
+            inner.emplace_back();
+        } else {
+            i = index[at] - 1;
+
+            if (named[i].decl->kind != Node::Kind::NamespaceDecl || decl->kind != Node::Kind::NamespaceDecl) {
+                named[i].decl = decl;
+                inner[i].clear();
+            }
+        }
+
+        if (decl->kind == Node::Kind::NamespaceDecl) {
+            for (auto& member: static_cast<NamespaceDeclaration*>(decl)->decls) {
+                inner[i].push_back(member.get());
+            }
+        }
+    }
+
+    std::vector<uint64_t> hashes;
+    for (size_t i = 0; i < named.size(); ++i) {
+        if (named[i].decl->kind == Node::Kind::NamespaceDecl) {
+            named[i].members.reset(new Exports(inner[i], hash_of));
+        }
+
+        hashes.push_back(named[i].hash);
+    }
+
+    std::vector<uint32_t> keys;
+
+    if (!perfect(hashes, seeds, keys)) {
+        seeds.clear();
+        entries = std::move(named);
+        return;
+    }
+
+    entries.reserve(keys.size());
+    for (uint32_t key: keys) {
+        entries.push_back(std::move(named[key]));
+    }
+}
+
+const Exports::Entry *Exports::find(const std::string& name, uint64_t hash) const {
+    if (entries.empty()) {
+        return nullptr;
+    }
+
+    if (!seeds.empty()) {
+        const Entry& entry = entries[slot(hash, seeds[bucket(hash, seeds.size())], entries.size())];
+        return entry.hash == hash && entry.name == name ? &entry : nullptr;
+    }
+
+    for (auto& entry: entries) {
+        if (entry.hash == hash && entry.name == name) {
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
+
+// Fibonacci hashing, the high half of the product is the best mixed
+size_t Exports::bucket(uint64_t hash, size_t buckets) {
+    return ((hash * 0x9E3779B97F4A7C15ULL) >> 32) % buckets;
+}
+
+// The hash displaced by the seed then mixed, with the finalizer of splitmix64.
+// The seed of a bucket of one key may be that key's slot instead, marked by the top bit.
+size_t Exports::slot(uint64_t hash, uint32_t seed, size_t slots) {
+    if (seed & direct) {
+        return seed & ~direct;
+    }
+
+    uint64_t mixed = hash ^ (seed * 0x9E3779B97F4A7C15ULL);
+
+    mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBULL;
+    mixed ^= mixed >> 31;
+
+    return mixed % slots;
+}
+
+// Buckets of two keys on average are given a seed fullest first, while most slots are still free.
+// The seed of a bucket is the first that sends all its keys to free slots. The buckets of one key come last and take
+// the slots left directly: searching seeds for them is what gets slow as the table fills up.
+bool Exports::perfect(const std::vector<uint64_t>& hashes, std::vector<uint32_t>& seeds, std::vector<uint32_t>& keys) {
+    size_t count = hashes.size();
+
+    seeds.assign((count + 1) / 2, 0);
+    keys.assign(count, 0);
+
+    if (!count) {
+        return true;
+    }
+
+    // Direct slots must be below the mark
+    if (count >= direct) {
+        return false;
+    }
+
+    // The keys of bucket b are members[first[b]] up to members[first[b + 1]]
+    std::vector<uint32_t> first(seeds.size() + 1, 0);
+    std::vector<uint32_t> members(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        first[bucket(hashes[i], seeds.size()) + 1]++;
+    }
+
+    for (size_t b = 0; b < seeds.size(); ++b) {
+        first[b + 1] += first[b];
+    }
+
+    std::vector<uint32_t> filled(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        members[filled[bucket(hashes[i], seeds.size())]++] = i;
+    }
+
+    auto size = [&](uint32_t b) -> size_t { return first[b + 1] - first[b]; };
+
+    // Fullest first, by counting
+    size_t largest = 0;
+    for (size_t b = 0; b < seeds.size(); ++b) {
+        largest = std::max(largest, size(b));
+    }
+
+    std::vector<uint32_t> at_size(largest + 2, 0);
+    for (size_t b = 0; b < seeds.size(); ++b) {
+        at_size[largest - size(b) + 1]++;
+    }
+
+    for (size_t s = 0; s <= largest; ++s) {
+        at_size[s + 1] += at_size[s];
+    }
+
+    std::vector<uint32_t> order(seeds.size());
+    for (size_t b = 0; b < seeds.size(); ++b) {
+        order[at_size[largest - size(b)]++] = b;
+    }
+
+    std::vector<bool> taken(count, false);
+    std::vector<size_t> placed;
+    size_t free = 0;
+
+    for (uint32_t b: order) {
+        if (size(b) == 0) {
+            break;
+        }
+
+        if (size(b) == 1) {
+            while (taken[free]) {
+                free++;
+            }
+
+            taken[free] = true;
+            keys[free] = members[first[b]];
+            seeds[b] = direct | free;
+            continue;
+        }
+
+        // No seed tells apart two keys of the same hash, they are always in the same bucket
+        for (uint32_t k = first[b]; k < first[b + 1]; ++k) {
+            for (uint32_t other = first[b]; other < k; ++other) {
+                if (hashes[members[k]] == hashes[members[other]]) {
+                    return false;
+                }
+            }
+        }
+
+        for (uint32_t seed = 0; ; ++seed) {
+            if (seed == max_seed) {
+                return false;
+            }
+
+            placed.clear();
+
+            for (uint32_t k = first[b]; k < first[b + 1]; ++k) {
+                size_t at = slot(hashes[members[k]], seed, count);
+
+                if (taken[at] || std::find(placed.begin(), placed.end(), at) != placed.end()) {
+                    break;
+                }
+
+                placed.push_back(at);
+            }
+
+            if (placed.size() == size(b)) {
+                for (size_t k = 0; k < placed.size(); ++k) {
+                    taken[placed[k]] = true;
+                    keys[placed[k]] = members[first[b] + k];
+                }
+
+                seeds[b] = seed;
+                break;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,38 @@
+#include <Files.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <process.h>
+#define getpid _getpid
+#endif
+
+bool read_file(const std::string& path, std::string& contents) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    char buffer[1 << 16];
+    size_t read;
+
+    contents.clear();
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, read);
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+
+    return ok;
+}
+
+// The process, then a count of the names it made
+std::string temporary_path(const std::string& path) {
+    static std::atomic<uint64_t> made(0);
+    return path + ".tmp" + std::to_string(getpid()) + '-' + std::to_string(made++);
+}
@@ -0,0 +1,910 @@
+#include <Interface.hpp>
+#include <Exports.hpp>
+#include <Files.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t interface_version = 7;
+static const uint32_t byte_order_mark = 0x01020304;
+
+// Marks a missing type or reference list
+static const uint32_t none = 0xFFFFFFFF;
+
+enum HeaderWord {
+    header_magic, header_version, header_byte_order,
+    header_surface_low, header_surface_high,
+    header_fingerprint_low, header_fingerprint_high,
+    header_dependencies_at, header_dependencies_count,
+    header_uses_at, header_uses_count,
+    header_imports_at, header_imports_count,
+    header_declarations_at, header_declarations_count,
+    header_names_at,
+    header_seeds_at, header_seeds_count,
+    header_slots_at, header_slots_count,
+    header_strings_at,
+    header_words
+};
+
+struct Interface::Writer {
+    std::vector<uint32_t> words;
+    std::vector<uint32_t> strings;
+    std::unordered_map<std::string, uint32_t> interned;
+
+    // Top-level names the declaration being written refers to
+    std::vector<std::string> references;
+    std::unordered_set<std::string> referenced;
+
+    uint32_t string(const std::string& str) {
+        auto found = interned.find(str);
+        if (found != interned.end()) {
+            return found->second;
+        }
+
+        uint32_t ref = strings.size();
+        strings.push_back(str.size());
+        strings.resize(strings.size() + (str.size() + 3) / 4, 0);
+        memcpy(&strings[ref + 1], str.data(), str.size());
+
+        interned[str] = ref;
+        return ref;
+    }
+
+    // Of what the declarations export, locations and reference lists left out
+    uint64_t surface = Interface::hash_basis;
+
+    // Declaration words go through put() and name(), hashed as they are written
+    void put(uint32_t word) {
+        words.push_back(word);
+        surface = hash(surface, &word, sizeof(word));
+    }
+
+    void name(const std::string& str) {
+        words.push_back(string(str));
+
+        uint32_t length = str.size();
+        surface = hash(surface, &length, sizeof(length));
+        surface = hash(surface, str.data(), str.size());
+    }
+
+    void position(const Token& token) {
+        words.push_back(token.line);
+        words.push_back(token.column);
+    }
+
+    void templates(const std::vector<TemplateDeclaration>& temps) {
+        put(temps.size());
+        for (auto& temp: temps) {
+            name(temp.name);
+        }
+    }
+
+    void type(Type *type);
+    void declaration(Declaration *decl, bool top);
+
+    // Namespaces and type declarations skip what failed to parse
+    template <typename T>
+    void declarations(const std::vector<std::unique_ptr<T>>& decls) {
+        put(std::count_if(decls.begin(), decls.end(), [](const std::unique_ptr<T>& decl) { return decl->kind != Node::Kind::SyntaxError; }));
+
+        for (auto& decl: decls) {
+            if (decl->kind != Node::Kind::SyntaxError) {
+                declaration(decl.get(), false);
+            }
+        }
+    }
+};
+
+void Interface::Writer::type(Type *type) {
+    if (!type) {
+        put(none);
+        return;
+    }
+
+    put(static_cast<uint32_t>(type->kind));
+
+    switch (type->kind) {
+        case Node::Kind::BaseType: {
+            auto base = static_cast<BaseType*>(type);
+
+            // a::b refers to the top-level a
+            std::string top = base->name.substr(0, base->name.find("::"));
+            if (referenced.insert(top).second) {
+                references.push_back(top);
+            }
+
+            name(base->name);
+            put(base->templates.size());
+            for (auto& temp: base->templates) {
+                this->type(temp.get());
+            }
+            break;
+        }
+        case Node::Kind::PointerType:
+            this->type(static_cast<PointerType*>(type)->inner.get());
+            break;
+        case Node::Kind::ArrayType:
+            this->type(static_cast<ArrayType*>(type)->inner.get());
+            break;
+        case Node::Kind::ClosureType: {
+            auto closure = static_cast<ClosureType*>(type);
+
+            put(closure->argTypes.size());
+            for (auto& arg: closure->argTypes) {
+                this->type(arg.get());
+            }
+
+            this->type(closure->returnType.get());
+            break;
+        }
+        case Node::Kind::FuncType: {
+            auto func = static_cast<FunctionType*>(type);
+
+            put(func->argTypes.size());
+            for (auto& arg: func->argTypes) {
+                this->type(arg.get());
+            }
+
+            this->type(func->returnType.get());
+            break;
+        }
+        case Node::Kind::TupleType: {
+            auto tuple = static_cast<TupleType*>(type);
+
+            put(tuple->types.size());
+            for (auto& inner: tuple->types) {
+                this->type(inner.get());
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void Interface::Writer::declaration(Declaration *decl, bool top) {
+    if (top) {
+        references.clear();
+        referenced.clear();
+    }
+
+    put(static_cast<uint32_t>(decl->kind));
+    name(declaration_name(decl));
+    position(decl->token);
+
+    // Patched once the references of a top-level declaration are known
+    size_t references_at = words.size();
+    words.push_back(none);
+
+    switch (decl->kind) {
+        case Node::Kind::NamespaceDecl:
+            declarations(static_cast<NamespaceDeclaration*>(decl)->decls);
+            break;
+        case Node::Kind::FuncDecl: {
+            auto fDecl = static_cast<FunctionDeclaration*>(decl);
+
+            put(fDecl->is_extern | fDecl->is_inline << 1);
+            templates(fDecl->templates);
+
+            put(fDecl->arglist.size());
+            for (auto& arg: fDecl->arglist) {
+                name(arg->name);
+                position(arg->token);
+                type(arg->type.get());
+            }
+
+            type(fDecl->return_type.get());
+            break;
+        }
+        case Node::Kind::StructDecl: {
+            auto sDecl = static_cast<StructDeclaration*>(decl);
+
+            // Alignments are at most 1 << 16, they fit above the flags
+            put(sDecl->reorder | sDecl->packed << 1 | sDecl->soa << 2 | sDecl->align << 8);
+            templates(sDecl->templates);
+
+            put(sDecl->fields.size());
+            for (auto& field: sDecl->fields) {
+                name(field->name);
+                position(field->token);
+                put(field->static_mod | field->extern_mod << 1 | field->packed << 2 | field->align << 8);
+                type(field->type.get());
+            }
+
+            declarations(sDecl->subdecls);
+            break;
+        }
+        case Node::Kind::VariantDecl: {
+            auto vDecl = static_cast<VariantDeclaration*>(decl);
+
+            templates(vDecl->templates);
+            type(vDecl->from_type.get());
+
+            put(vDecl->fields.size());
+            for (auto& member: vDecl->fields) {
+                name(member.name);
+                type(member.type.get());
+                put(static_cast<uint64_t>(member.value) & 0xFFFFFFFF);
+                put(static_cast<uint64_t>(member.value) >> 32);
+            }
+
+            declarations(vDecl->subdecls);
+            break;
+        }
+        case Node::Kind::AliasDecl: {
+            auto aDecl = static_cast<AliasDeclaration*>(decl);
+
+            templates(aDecl->templates);
+            type(aDecl->from_type.get());
+            break;
+        }
+        case Node::Kind::VariableDecl: {
+            auto vDecl = static_cast<VariableDeclaration*>(decl);
+
+            // The type of `a := b` is only known after inference, it is written as none for now
+            put(vDecl->static_mod | vDecl->extern_mod << 1);
+            type(vDecl->type.get());
+
+            // and the declaration's text, initializer included, stands for it in the surface
+            if (!vDecl->type && vDecl->init_expr) {
+                uint32_t length = vDecl->token.length;
+                surface = hash(surface, &length, sizeof(length));
+                surface = hash(surface, vDecl->token.start, length);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    if (top) {
+        words[references_at] = words.size();
+
+        words.push_back(references.size());
+        for (auto& name: references) {
+            words.push_back(string(name));
+        }
+    }
+}
+
+uint64_t Interface::surface(Unit *unit) {
+    Writer writer;
+
+    for (auto& decl: unit->decls) {
+        if (decl->kind != Node::Kind::SyntaxError) {
+            writer.declaration(decl.get(), true);
+        }
+    }
+
+    return writer.surface;
+}
+
+bool Interface::write(Unit *unit, uint64_t fingerprint, const std::vector<Dependency>& dependencies, const std::string& path) {
+    Writer writer;
+    auto& words = writer.words;
+
+    words.resize(header_words, 0);
+    memcpy(&words[header_magic], "SKYI", 4);
+    words[header_version] = interface_version;
+    words[header_byte_order] = byte_order_mark;
+    words[header_fingerprint_low] = fingerprint & 0xFFFFFFFF;
+    words[header_fingerprint_high] = fingerprint >> 32;
+
+    words[header_dependencies_at] = words.size();
+    words[header_dependencies_count] = dependencies.size();
+    for (auto& dependency: dependencies) {
+        words.push_back(writer.string(dependency.path));
+        words.push_back(dependency.fingerprint & 0xFFFFFFFF);
+        words.push_back(dependency.fingerprint >> 32);
+    }
+
+    words[header_uses_at] = words.size();
+    words[header_uses_count] = unit->uses.size();
+    for (auto& use: unit->uses) {
+        words.push_back(writer.string(use->lib_name));
+        words.push_back(writer.string(use->unit_path));
+        writer.position(use->token);
+    }
+
+    words[header_imports_at] = words.size();
+    words[header_imports_count] = unit->imports.size();
+    for (auto& import: unit->imports) {
+        words.push_back(writer.string(import->unit_path));
+        writer.position(import->token);
+
+        words.push_back(import->names.size());
+        for (auto& name: import->names) {
+            words.push_back(writer.string(name));
+        }
+    }
+
+    // Records first, the declarations section points at them
+    std::vector<std::string> names;
+    std::vector<uint32_t> records;
+
+    for (auto& decl: unit->decls) {
+        if (decl->kind == Node::Kind::SyntaxError) {
+            continue;
+        }
+
+        names.push_back(declaration_name(decl.get()));
+        records.push_back(words.size());
+        writer.declaration(decl.get(), true);
+    }
+
+    words[header_surface_low] = writer.surface & 0xFFFFFFFF;
+    words[header_surface_high] = writer.surface >> 32;
+
+    words[header_declarations_at] = words.size();
+    words[header_declarations_count] = records.size();
+    for (size_t i = 0; i < records.size(); ++i) {
+        words.push_back(writer.string(names[i]));
+        words.push_back(records[i]);
+    }
+
+    std::vector<uint32_t> order(names.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return names[a] < names[b]; });
+
+    words[header_names_at] = words.size();
+    words.insert(words.end(), order.begin(), order.end());
+
+    // Where each distinct name starts in order
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> starts;
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i == 0 || names[order[i]] != names[order[i - 1]]) {
+            hashes.push_back(hash(hash_basis, names[order[i]].data(), names[order[i]].size()));
+            starts.push_back(i);
+        }
+    }
+
+    std::vector<uint32_t> seeds, keys;
+    if (!Exports::perfect(hashes, seeds, keys)) {
+        seeds.clear();
+        keys.clear();
+    }
+
+    words[header_seeds_at] = words.size();
+    words[header_seeds_count] = seeds.size();
+    words.insert(words.end(), seeds.begin(), seeds.end());
+
+    words[header_slots_at] = words.size();
+    words[header_slots_count] = keys.size();
+    for (uint32_t key: keys) {
+        words.push_back(starts[key]);
+    }
+
+    words[header_strings_at] = words.size();
+    words.insert(words.end(), writer.strings.begin(), writer.strings.end());
+
+    // Written aside then renamed, importers never see half a file
+    std::string temp = temporary_path(path);
+    FILE *file = fopen(temp.c_str(), "wb");
+
+    if (!file) {
+        return false;
+    }
+
+    bool ok = fwrite(words.data(), sizeof(uint32_t), words.size(), file) == words.size();
+    ok = fclose(file) == 0 && ok;
+
+    if (ok && std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(path.c_str());
+        ok = std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+
+    if (!ok) {
+        std::remove(temp.c_str());
+    }
+
+    return ok;
+}
+
+std::unique_ptr<Interface> Interface::open(const std::string& path) {
+    std::unique_ptr<Interface> interface(new Interface());
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(header_words * sizeof(uint32_t))) {
+        close(fd);
+        return nullptr;
+    }
+
+    void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        return nullptr;
+    }
+
+    interface->mapping = mapped;
+    interface->mapping_size = info.st_size;
+    interface->words = static_cast<const uint32_t*>(mapped);
+    interface->count = info.st_size / sizeof(uint32_t);
+#else
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return nullptr;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    interface->copy.resize(length > 0 ? length / sizeof(uint32_t) : 0);
+    size_t read = fread(interface->copy.data(), sizeof(uint32_t), interface->copy.size(), file);
+    fclose(file);
+
+    if (read != interface->copy.size() || read < header_words) {
+        return nullptr;
+    }
+
+    interface->words = interface->copy.data();
+    interface->count = interface->copy.size();
+#endif
+
+    if (!interface->start()) {
+        return nullptr;
+    }
+
+    return interface;
+}
+
+std::unique_ptr<Interface> Interface::open(const char *data, size_t size) {
+    std::unique_ptr<Interface> interface(new Interface());
+
+    if (reinterpret_cast<uintptr_t>(data) % sizeof(uint32_t) != 0 || size < header_words * sizeof(uint32_t)) {
+        return nullptr;
+    }
+
+    interface->words = reinterpret_cast<const uint32_t*>(data);
+    interface->count = size / sizeof(uint32_t);
+
+    if (!interface->start()) {
+        return nullptr;
+    }
+
+    return interface;
+}
+
+bool Interface::start() {
+    if (memcmp(&words[header_magic], "SKYI", 4) != 0 || words[header_version] != interface_version || words[header_byte_order] != byte_order_mark) {
+        return false;
+    }
+
+    stored_surface = words[header_surface_low] | static_cast<uint64_t>(words[header_surface_high]) << 32;
+    stored_fingerprint = words[header_fingerprint_low] | static_cast<uint64_t>(words[header_fingerprint_high]) << 32;
+
+    dependencies_at = words[header_dependencies_at];
+    dependencies_count = words[header_dependencies_count];
+    uses_at = words[header_uses_at];
+    uses_count = words[header_uses_count];
+    imports_at = words[header_imports_at];
+    imports_count = words[header_imports_count];
+    declarations_at = words[header_declarations_at];
+    declarations_count = words[header_declarations_count];
+    names_at = words[header_names_at];
+    seeds_at = words[header_seeds_at];
+    seeds_count = words[header_seeds_count];
+    slots_at = words[header_slots_at];
+    slots_count = words[header_slots_count];
+    strings_at = words[header_strings_at];
+
+    // Sections looked up by index must be whole, the rest is checked word by word
+    if (declarations_at + 2 * declarations_count > count || names_at + declarations_count > count || strings_at > count
+        || seeds_at + seeds_count > count || slots_at + slots_count > count || (slots_count != 0) != (seeds_count != 0)) {
+        return false;
+    }
+
+    built.resize(declarations_count);
+    return true;
+}
+
+bool Interface::fresh(const std::string& path) {
+    struct stat unit_info, interface_info;
+
+    if (stat((path + 'i').c_str(), &interface_info) != 0) {
+        return false;
+    }
+
+    return stat(path.c_str(), &unit_info) != 0 || unit_info.st_mtime < interface_info.st_mtime;
+}
+
+Interface::~Interface() {
+#ifndef _WIN32
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+#endif
+}
+
+// Reads a record in order
+struct Interface::Cursor {
+    const Interface *interface;
+    size_t at;
+
+    // Of the declaration being built, given to its types too
+    Token token;
+
+    uint32_t next() {
+        return interface->word(at++);
+    }
+
+    // Of a list, every element takes a word at least
+    uint32_t count() {
+        uint32_t count = next();
+        if (count > interface->count - at) {
+            throw std::runtime_error("Interface is corrupt.");
+        }
+
+        return count;
+    }
+
+    std::string string() {
+        return interface->string(next());
+    }
+
+    Token position() {
+        int line = next();
+        int column = next();
+        return { 0, line, column, nullptr, 0 };
+    }
+};
+
+uint32_t Interface::word(size_t at) const {
+    if (at >= count) {
+        throw std::runtime_error("Interface is truncated.");
+    }
+
+    return words[at];
+}
+
+std::string Interface::string(uint32_t ref) const {
+    size_t at = strings_at + ref;
+    uint32_t length = word(at);
+
+    if (at + 1 + (length + 3) / 4 > count) {
+        throw std::runtime_error("Interface is truncated.");
+    }
+
+    return std::string(reinterpret_cast<const char*>(words + at + 1), length);
+}
+
+std::unique_ptr<Unit> Interface::header(const std::string& path) {
+    auto unit = std::make_unique<Unit>(path, nullptr);
+    Cursor cursor { this, uses_at, Token::empty };
+
+    for (size_t i = 0; i < uses_count; ++i) {
+        std::string lib = cursor.string();
+        std::string unit_path = cursor.string();
+
+        unit->addUse(new Use(cursor.position(), lib, unit_path));
+    }
+
+    cursor.at = imports_at;
+
+    for (size_t i = 0; i < imports_count; ++i) {
+        std::string unit_path = cursor.string();
+        Token token = cursor.position();
+
+        std::vector<std::string> names(cursor.count());
+        for (auto& name: names) {
+            name = cursor.string();
+        }
+
+        unit->addImport(new Import(token, unit_path, names));
+    }
+
+    return unit;
+}
+
+std::vector<Interface::Dependency> Interface::dependencies() const {
+    Cursor cursor { this, dependencies_at, Token::empty };
+    std::vector<Dependency> dependencies;
+
+    for (size_t i = 0; i < dependencies_count; ++i) {
+        std::string path = cursor.string();
+        uint64_t low = cursor.next();
+        uint64_t high = cursor.next();
+
+        dependencies.push_back({ path, low | high << 32 });
+    }
+
+    return dependencies;
+}
+
+std::vector<size_t> Interface::find(const std::string& name) const {
+    // Compares a declaration's name with name without copying it
+    auto compare = [&](uint32_t index) -> int {
+        size_t at = strings_at + word(declarations_at + 2 * index);
+        uint32_t length = word(at);
+
+        if (at + 1 + (length + 3) / 4 > count) {
+            throw std::runtime_error("Interface is truncated.");
+        }
+
+        int order = memcmp(words + at + 1, name.data(), std::min<size_t>(length, name.size()));
+        if (order != 0) {
+            return order;
+        }
+
+        return length < name.size() ? -1 : length > name.size() ? 1 : 0;
+    };
+
+    size_t low = 0, high = declarations_count;
+
+    if (slots_count) {
+        uint64_t hashed = hash(hash_basis, name.data(), name.size());
+        low = word(slots_at + Exports::slot(hashed, word(seeds_at + Exports::bucket(hashed, seeds_count)), slots_count));
+        high = low;
+    }
+
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+
+        if (compare(word(names_at + middle)) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    std::vector<size_t> found;
+    for (size_t i = low; i < declarations_count && compare(word(names_at + i)) == 0; ++i) {
+        found.push_back(word(names_at + i));
+    }
+
+    return found;
+}
+
+std::vector<std::string> Interface::references(size_t i) const {
+    Cursor cursor { this, word(word(declarations_at + 2 * i + 1) + 4), Token::empty };
+
+    std::vector<std::string> names(cursor.count());
+    for (auto& name: names) {
+        name = cursor.string();
+    }
+
+    return names;
+}
+
+Declaration *Interface::declaration(size_t i) {
+    if (!built[i]) {
+        Cursor cursor { this, word(declarations_at + 2 * i + 1), Token::empty };
+        built[i] = build(cursor);
+    }
+
+    return built[i].get();
+}
+
+std::vector<TemplateDeclaration> Interface::build_templates(Cursor& cursor) {
+    std::vector<TemplateDeclaration> temps;
+
+    size_t count = cursor.count();
+    for (size_t i = 0; i < count; ++i) {
+        temps.emplace_back(cursor.token, cursor.string());
+    }
+
+    return temps;
+}
+
+std::unique_ptr<Type> Interface::build_type(Cursor& cursor) {
+    uint32_t kind = cursor.next();
+
+    if (kind == none) {
+        return nullptr;
+    }
+
+    switch (static_cast<Node::Kind>(kind)) {
+        case Node::Kind::BaseType: {
+            std::unique_ptr<BaseType> base(new BaseType(cursor.token, cursor.string()));
+
+            size_t count = cursor.count();
+            for (size_t i = 0; i < count; ++i) {
+                base->templates.push_back(build_type(cursor));
+            }
+
+            return base;
+        }
+        case Node::Kind::PointerType:
+        case Node::Kind::ArrayType: {
+            auto inner = build_type(cursor);
+            if (!inner) {
+                break;
+            }
+
+            if (static_cast<Node::Kind>(kind) == Node::Kind::PointerType) {
+                return std::unique_ptr<Type>(new PointerType(cursor.token, inner.release()));
+            }
+
+            return std::unique_ptr<Type>(new ArrayType(cursor.token, inner.release()));
+        }
+        case Node::Kind::ClosureType:
+        case Node::Kind::FuncType: {
+            std::vector<std::unique_ptr<Type>> args(cursor.count());
+            for (auto& arg: args) {
+                if (!(arg = build_type(cursor))) {
+                    throw std::runtime_error("Interface is corrupt.");
+                }
+            }
+
+            auto ret = build_type(cursor);
+
+            if (static_cast<Node::Kind>(kind) == Node::Kind::ClosureType) {
+                return std::unique_ptr<Type>(new ClosureType(cursor.token, std::move(args), ret.release()));
+            }
+
+            return std::unique_ptr<Type>(new FunctionType(cursor.token, std::move(args), ret.release()));
+        }
+        case Node::Kind::TupleType: {
+            std::vector<std::unique_ptr<Type>> types(cursor.count());
+            for (auto& type: types) {
+                type = build_type(cursor);
+            }
+
+            return std::unique_ptr<Type>(new TupleType(cursor.token, std::move(types)));
+        }
+        default:
+            break;
+    }
+
+    throw std::runtime_error("Interface is corrupt.");
+}
+
+std::unique_ptr<Declaration> Interface::build(Cursor& cursor) {
+    uint32_t kind = cursor.next();
+    std::string name = cursor.string();
+
+    cursor.token = cursor.position();
+
+    // References are only read by references()
+    cursor.next();
+
+    switch (static_cast<Node::Kind>(kind)) {
+        case Node::Kind::NamespaceDecl: {
+            std::unique_ptr<NamespaceDeclaration> ns(new NamespaceDeclaration(cursor.token, name));
+
+            size_t count = cursor.count();
+            for (size_t i = 0; i < count; ++i) {
+                ns->addDeclaration(build(cursor).release());
+            }
+
+            return ns;
+        }
+        case Node::Kind::FuncDecl: {
+            uint32_t flags = cursor.next();
+            std::unique_ptr<FunctionDeclaration> fDecl(new FunctionDeclaration(cursor.token, name, flags & 1, flags & 2));
+
+            fDecl->templates = build_templates(cursor);
+
+            size_t count = cursor.count();
+            for (size_t i = 0; i < count; ++i) {
+                std::string arg_name = cursor.string();
+                Token token = cursor.position();
+
+                std::unique_ptr<VariableDeclaration> arg(new VariableDeclaration(token, arg_name, build_type(cursor).release()));
+                arg->parent = fDecl.get();
+                fDecl->arglist.push_back(std::move(arg));
+            }
+
+            fDecl->return_type = build_type(cursor);
+            return fDecl;
+        }
+        case Node::Kind::StructDecl: {
+            std::unique_ptr<StructDeclaration> sDecl(new StructDeclaration(cursor.token, name));
+
+            uint32_t attributes = cursor.next();
+            sDecl->reorder = attributes & 1;
+            sDecl->packed = attributes & 2;
+            sDecl->soa = attributes & 4;
+            sDecl->align = attributes >> 8;
+            sDecl->templates = build_templates(cursor);
+
+            size_t count = cursor.count();
+            for (size_t i = 0; i < count; ++i) {
+                std::string field_name = cursor.string();
+                Token token = cursor.position();
+                uint32_t flags = cursor.next();
+
+                auto field = new VariableDeclaration(token, field_name, build_type(cursor).release());
+                field->static_mod = flags & 1;
+                field->extern_mod = flags & 2;
+                field->packed = flags & 4;
+                field->align = flags >> 8;
+                sDecl->addField(field);
+            }
+
+            count = cursor.count();
+            for (size_t i = 0; i < count; ++i) {
+                auto sub = build(cursor);
+                if (!dynamic_cast<TypeDeclaration*>(sub.get())) {
+                    throw std::runtime_error("Interface is corrupt.");
+                }
+
+                sDecl->addSubdecl(static_cast<TypeDeclaration*>(sub.release()));
+            }
+
+            return sDecl;
+        }
+        case Node::Kind::VariantDecl: {
+            Token token = cursor.token;
+            auto temps = build_templates(cursor);
+            auto from_type = build_type(cursor);
+
+            std::unique_ptr<VariantDeclaration> vDecl(new VariantDeclaration(token, name, from_type.release(), std::move(temps)));
+
+            size_t count = cursor.count();
+            for (size_t i = 0; i < count; ++i) {
+                std::string member_name = cursor.string();
+                auto type = build_type(cursor);
+
+                if (type && type->kind != Node::Kind::TupleType) {
+                    throw std::runtime_error("Interface is corrupt.");
+                }
+
+                uint64_t low = cursor.next();
+                uint64_t high = cursor.next();
+                vDecl->addField(member_name, static_cast<TupleType*>(type.release()), static_cast<int64_t>(low | high << 32));
+            }
+
+            count = cursor.count();
+            for (size_t i = 0; i < count; ++i) {
+                auto sub = build(cursor);
+                if (!dynamic_cast<TypeDeclaration*>(sub.get())) {
+                    throw std::runtime_error("Interface is corrupt.");
+                }
+
+                vDecl->addSubdecl(static_cast<TypeDeclaration*>(sub.release()));
+            }
+
+            return vDecl;
+        }
+        case Node::Kind::AliasDecl: {
+            Token token = cursor.token;
+            auto temps = build_templates(cursor);
+            auto from_type = build_type(cursor);
+
+            if (!from_type) {
+                break;
+            }
+
+            return std::unique_ptr<Declaration>(new AliasDeclaration(token, name, from_type.release(), std::move(temps)));
+        }
+        case Node::Kind::VariableDecl: {
+            uint32_t flags = cursor.next();
+            std::unique_ptr<VariableDeclaration> vDecl(new VariableDeclaration(cursor.token, name, build_type(cursor).release()));
+
+            vDecl->static_mod = flags & 1;
+            vDecl->extern_mod = flags & 2;
+            return vDecl;
+        }
+        case Node::Kind::TemplateDecl:
+            return std::unique_ptr<Declaration>(new TemplateDeclaration(cursor.token, name));
+        default:
+            break;
+    }
+
+    throw std::runtime_error("Interface is corrupt.");
+}
@@ -0,0 +1,550 @@
+#include <Layout.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+// Template parameters of the declaration being laid out and the layouts of its arguments
+struct Layout::Env {
+    const std::vector<TemplateDeclaration> *params;
+    const std::vector<Shape> *args;
+};
+
+static const std::vector<TemplateDeclaration> *templates_of(Declaration *decl) {
+    switch (decl->kind) {
+        case Node::Kind::StructDecl:
+            return &static_cast<StructDeclaration*>(decl)->templates;
+        case Node::Kind::VariantDecl:
+            return &static_cast<VariantDeclaration*>(decl)->templates;
+        case Node::Kind::AliasDecl:
+            return &static_cast<AliasDeclaration*>(decl)->templates;
+        default:
+            return nullptr;
+    }
+}
+
+void Layout::own(Declaration *decl, const Owner& owner) {
+    switch (decl->kind) {
+        case Node::Kind::NamespaceDecl:
+            for (auto& member: static_cast<NamespaceDeclaration*>(decl)->decls) {
+                own(member.get(), owner);
+            }
+            return;
+        case Node::Kind::StructDecl: {
+            auto sDecl = static_cast<StructDeclaration*>(decl);
+
+            for (auto& field: sDecl->fields) {
+                field->offset = -1;
+            }
+
+            for (auto& sub: sDecl->subdecls) {
+                own(sub.get(), owner);
+            }
+            break;
+        }
+        case Node::Kind::VariantDecl:
+            for (auto& sub: static_cast<VariantDeclaration*>(decl)->subdecls) {
+                own(sub.get(), owner);
+            }
+            break;
+        case Node::Kind::AliasDecl:
+            break;
+        default:
+            return;
+    }
+
+    auto type = static_cast<TypeDeclaration*>(decl);
+    type->size = -1;
+    type->alignment = -1;
+
+    owned[type] = owner;
+    pending.push_back(type);
+}
+
+void Layout::add(const std::vector<Declaration*>& decls, Unit *unit, ErrorHandler *errors) {
+    for (Declaration *decl: decls) {
+        own(decl, { unit, errors });
+    }
+}
+
+// Declarations with template parameters are only laid out instantiated
+void Layout::lay() {
+    for (TypeDeclaration *decl: pending) {
+        errors = owned[decl].errors;
+
+        Shape shape;
+        if (templates_of(decl)->empty()) {
+            declared(decl, {}, shape);
+        }
+    }
+
+    pending.clear();
+}
+
+void Layout::fold(Unit *unit, ErrorHandler *errors) {
+    this->errors = errors;
+
+    for (Node *node: unit->nodes(Node::Kind::Sizeof)) {
+        auto sof = static_cast<Sizeof*>(node);
+        Type *type = sof->arg_type.get();
+        Shape shape;
+
+        if (!type && sof->expr) {
+            type = sof->expr->type.get();
+
+            if (sof->expr->kind == Node::Kind::VariableAcc) {
+                auto vAcc = static_cast<VariableAccess*>(sof->expr.get());
+                Declaration *ref = vAcc->ref;
+
+                // A variable is the size of its declared type
+                if (ref && ref->kind == Node::Kind::VariableDecl) {
+                    type = static_cast<VariableDeclaration*>(ref)->type.get();
+                }
+
+                // A type parsed as an expression, sizeof(Point) or sizeof(Box<int8>)
+                if (ref && templates_of(ref)) {
+                    std::vector<Shape> args(vAcc->templates.size());
+                    bool known = true;
+
+                    for (size_t i = 0; known && i < args.size(); ++i) {
+                        known = of(vAcc->templates[i].get(), nullptr, args[i]);
+                    }
+
+                    sof->value = known && declared(static_cast<TypeDeclaration*>(ref), args, shape) ? shape.size : -1;
+                    continue;
+                }
+            }
+        }
+
+        sof->value = type && of(type, nullptr, shape) ? shape.size : -1;
+    }
+}
+
+// type, seen through the aliases without template parameters it names
+static Type *resolved(Type *type) {
+    // Aliases of one another never end
+    for (int hops = 0; type && hops < 64; ++hops) {
+        if (type->kind != Node::Kind::BaseType) {
+            return type;
+        }
+
+        auto base = static_cast<BaseType*>(type);
+        if (!base->ref || base->ref->kind != Node::Kind::AliasDecl) {
+            return type;
+        }
+
+        auto alias = static_cast<AliasDeclaration*>(base->ref);
+        if (!alias->templates.empty()) {
+            return type;
+        }
+
+        type = alias->from_type.get();
+    }
+
+    return nullptr;
+}
+
+static StructDeclaration *struct_of(Type *type) {
+    if (!type || type->kind != Node::Kind::BaseType) {
+        return nullptr;
+    }
+
+    Declaration *ref = static_cast<BaseType*>(type)->ref;
+    return ref && ref->kind == Node::Kind::StructDecl ? static_cast<StructDeclaration*>(ref) : nullptr;
+}
+
+// The declared type of a variable, or of a field or an element of one, nullptr for other expressions
+static Type *declared_type(Expression *expr) {
+    switch (expr->kind) {
+        case Node::Kind::VariableAcc: {
+            Declaration *ref = static_cast<VariableAccess*>(expr)->ref;
+            return ref && ref->kind == Node::Kind::VariableDecl ? static_cast<VariableDeclaration*>(ref)->type.get() : nullptr;
+        }
+        case Node::Kind::FieldAcc: {
+            auto fAcc = static_cast<FieldAccess*>(expr);
+            StructDeclaration *sDecl = struct_of(resolved(declared_type(fAcc->expr.get())));
+
+            for (size_t i = 0; sDecl && i < sDecl->fields.size(); ++i) {
+                if (sDecl->fields[i]->name == fAcc->field_name) {
+                    return sDecl->fields[i]->type.get();
+                }
+            }
+
+            return nullptr;
+        }
+        case Node::Kind::ArrayIndexing: {
+            Type *base = resolved(declared_type(static_cast<ArrayIndexing*>(expr)->base.get()));
+            return base && base->kind == Node::Kind::ArrayType ? static_cast<ArrayType*>(base)->inner.get() : nullptr;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+void Layout::lower(Unit *unit) {
+    for (Node *node: unit->nodes(Node::Kind::FieldAcc)) {
+        auto fAcc = static_cast<FieldAccess*>(node);
+        fAcc->column = fAcc->stride = -1;
+
+        if (fAcc->expr->kind != Node::Kind::ArrayIndexing) {
+            continue;
+        }
+
+        Type *array = resolved(declared_type(static_cast<ArrayIndexing*>(fAcc->expr.get())->base.get()));
+        if (!array || array->kind != Node::Kind::ArrayType) {
+            continue;
+        }
+
+        Type *element = resolved(static_cast<ArrayType*>(array)->inner.get());
+        StructDeclaration *sDecl = struct_of(element);
+
+        if (sDecl && sDecl->soa) {
+            column(static_cast<BaseType*>(element), fAcc->field_name, fAcc->column, fAcc->stride);
+        }
+    }
+}
+
+// Where the column of field starts in an array of element, a [soa] struct, per element: the sizes of the columns before it
+bool Layout::column(BaseType *element, const std::string& field, int& start, int& stride) {
+    auto sDecl = static_cast<StructDeclaration*>(element->ref);
+
+    std::vector<Shape> args(element->templates.size());
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (!of(element->templates[i].get(), nullptr, args[i])) {
+            return false;
+        }
+    }
+
+    if (args.size() != sDecl->templates.size()) {
+        return false;
+    }
+
+    Env env { &sDecl->templates, &args };
+
+    std::vector<Shape> parts(sDecl->fields.size());
+    std::vector<size_t> order;
+
+    for (size_t i = 0; i < parts.size(); ++i) {
+        auto& member = sDecl->fields[i];
+
+        // Not stored in the elements
+        if (member->static_mod || member->extern_mod) {
+            continue;
+        }
+
+        if (!member->type || !of(member->type.get(), &env, parts[i])) {
+            return false;
+        }
+
+        order.push_back(i);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return parts[a].alignment > parts[b].alignment; });
+
+    int before = 0;
+
+    for (size_t i: order) {
+        if (sDecl->fields[i]->name == field) {
+            start = before;
+            stride = parts[i].size;
+            return true;
+        }
+
+        before += parts[i].size;
+    }
+
+    return false;
+}
+
+bool Layout::of(Type *type, Shape& shape) {
+    return of(type, nullptr, shape);
+}
+
+bool Layout::of(Type *type, const Env *env, Shape& shape) {
+    switch (type->kind) {
+        case Node::Kind::BaseType: {
+            auto base = static_cast<BaseType*>(type);
+
+            // Types of interfaces are not bound, their template parameters are found by name
+            for (size_t i = 0; env && i < env->params->size(); ++i) {
+                auto& param = (*env->params)[i];
+
+                if (base->ref == &param || (!base->ref && base->name == param.name)) {
+                    shape = (*env->args)[i];
+                    return true;
+                }
+            }
+
+            if (!base->ref) {
+                shape.offsets.clear();
+                return builtin_layout(base->name, shape.size, shape.alignment);
+            }
+
+            if (base->ref->kind == Node::Kind::TemplateDecl) {
+                return false;
+            }
+
+            std::vector<Shape> args(base->templates.size());
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (!of(base->templates[i].get(), env, args[i])) {
+                    return false;
+                }
+            }
+
+            return declared(base->ref, args, shape);
+        }
+        case Node::Kind::TupleType: {
+            Shape tuple { 0, 1, {} };
+
+            for (auto& inner: static_cast<TupleType*>(type)->types) {
+                Shape part;
+                if (!of(inner.get(), env, part)) {
+                    return false;
+                }
+
+                int offset = align_up(tuple.size, part.alignment);
+                tuple.offsets.push_back(offset);
+                tuple.size = offset + part.size;
+                tuple.alignment = std::max(tuple.alignment, part.alignment);
+            }
+
+            tuple.size = align_up(tuple.size, tuple.alignment);
+            shape = tuple;
+            return true;
+        }
+        default:
+            // Pointers, arrays, closures and functions are the same whatever they point to
+            shape = { type->size(), type->alignment(), {} };
+            return shape.size >= 0;
+    }
+}
+
+// The layout of decl instantiated with args, its template arguments.
+// Declarations of other groups were laid out by their group, their instantiations are laid out here.
+bool Layout::declared(TypeDeclaration *decl, const std::vector<Shape>& args, Shape& shape) {
+    const std::vector<TemplateDeclaration> *params = templates_of(decl);
+
+    if (!params || params->size() != args.size()) {
+        return false;
+    }
+
+    auto owner = owned.find(decl);
+
+    if (args.empty() && owner == owned.end()) {
+        shape = { decl->size, decl->alignment, {} };
+
+        if (decl->kind == Node::Kind::StructDecl) {
+            for (auto& field: static_cast<StructDeclaration*>(decl)->fields) {
+                shape.offsets.push_back(field->offset);
+            }
+        }
+
+        return shape.size >= 0;
+    }
+
+    // Layouts are all an instantiation depends on
+    std::string key = std::to_string(reinterpret_cast<uintptr_t>(decl));
+    for (auto& arg: args) {
+        key += ':' + std::to_string(arg.size) + '/' + std::to_string(arg.alignment);
+    }
+
+    auto found = shapes.find(key);
+    if (found != shapes.end()) {
+        shape = found->second;
+        return shape.size >= 0;
+    }
+
+    if (!laying.insert(key).second) {
+        if (reported.insert(decl).second) {
+            std::string message = "Type " + declaration_name(decl) + " contains itself other than through a pointer.";
+
+            Unit *unit = owner != owned.end() ? owner->second.unit : nullptr;
+            ErrorHandler *to = owner != owned.end() ? owner->second.errors : errors;
+
+            if (unit) {
+                to->report(unit, decl->token, message);
+            } else if (to) {
+                to->report(message);
+            }
+        }
+
+        return false;
+    }
+
+    Env env { params, &args };
+    bool known = lay_out(decl, &env, shape);
+
+    laying.erase(key);
+
+    if (!known) {
+        shape = { -1, -1, {} };
+    }
+
+    shapes[key] = shape;
+
+    if (args.empty()) {
+        decl->size = shape.size;
+        decl->alignment = shape.alignment;
+
+        if (decl->kind == Node::Kind::StructDecl) {
+            auto& fields = static_cast<StructDeclaration*>(decl)->fields;
+
+            for (size_t i = 0; known && i < fields.size(); ++i) {
+                fields[i]->offset = shape.offsets[i];
+            }
+        }
+    }
+
+    return known;
+}
+
+bool Layout::lay_out(TypeDeclaration *decl, const Env *env, Shape& shape) {
+    switch (decl->kind) {
+        case Node::Kind::StructDecl: {
+            auto sDecl = static_cast<StructDeclaration*>(decl);
+            return fields(sDecl, env, reorder || sDecl->reorder, shape);
+        }
+        case Node::Kind::VariantDecl: {
+            auto vDecl = static_cast<VariantDeclaration*>(decl);
+            Shape tag { 4, 4, {} };
+
+            if (vDecl->from_type) {
+                if (!of(vDecl->from_type.get(), env, tag)) {
+                    return false;
+                }
+            } else {
+                for (auto& member: vDecl->fields) {
+                    if (member.value < std::numeric_limits<int32_t>::min() || member.value > std::numeric_limits<int32_t>::max()) {
+                        tag = { 8, 8, {} };
+                    }
+                }
+            }
+
+            Shape payload { 0, 1, {} };
+
+            for (auto& member: vDecl->fields) {
+                Shape part;
+                if (member.type && !of(member.type.get(), env, part)) {
+                    return false;
+                }
+
+                if (member.type) {
+                    payload.size = std::max(payload.size, part.size);
+                    payload.alignment = std::max(payload.alignment, part.alignment);
+                }
+            }
+
+            int offset = align_up(tag.size, payload.alignment);
+            int alignment = std::max(tag.alignment, payload.alignment);
+
+            shape = { align_up(offset + payload.size, alignment), alignment, { 0, offset } };
+            return true;
+        }
+        case Node::Kind::AliasDecl:
+            return of(static_cast<AliasDeclaration*>(decl)->from_type.get(), env, shape);
+        default:
+            return false;
+    }
+}
+
+// The fields stored in decl in order, or by decreasing alignment when reordered (in order among equally aligned ones).
+// The offsets stay by declaration index either way.
+// A packed field, or any field of a packed struct, is aligned to 1 unless it has an align attribute, which can only
+// raise an alignment. The struct is as aligned as its most aligned field, or its own align attribute if more.
+bool Layout::fields(StructDeclaration *decl, const Env *env, bool reordered, Shape& shape) {
+    std::vector<Shape> parts(decl->fields.size());
+    std::vector<size_t> order;
+
+    for (size_t i = 0; i < parts.size(); ++i) {
+        auto& field = decl->fields[i];
+
+        // Not stored in the struct
+        if (field->static_mod || field->extern_mod) {
+            continue;
+        }
+
+        if (!field->type || !of(field->type.get(), env, parts[i])) {
+            return false;
+        }
+
+        if (decl->packed || field->packed) {
+            parts[i].alignment = 1;
+        }
+
+        parts[i].alignment = std::max(parts[i].alignment, field->align);
+        order.push_back(i);
+    }
+
+    if (reordered) {
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return parts[a].alignment > parts[b].alignment; });
+    }
+
+    Shape layout { 0, std::max(1, decl->align), std::vector<int>(parts.size(), -1) };
+
+    for (size_t i: order) {
+        int offset = align_up(layout.size, parts[i].alignment);
+        layout.offsets[i] = offset;
+        layout.size = offset + parts[i].size;
+        layout.alignment = std::max(layout.alignment, parts[i].alignment);
+    }
+
+    layout.size = align_up(layout.size, layout.alignment);
+    shape = layout;
+    return true;
+}
+
+static void structs_of(Declaration *decl, std::vector<StructDeclaration*>& structs) {
+    if (decl->kind == Node::Kind::NamespaceDecl) {
+        for (auto& member: static_cast<NamespaceDeclaration*>(decl)->decls) {
+            structs_of(member.get(), structs);
+        }
+    } else if (decl->kind == Node::Kind::StructDecl) {
+        auto sDecl = static_cast<StructDeclaration*>(decl);
+        structs.push_back(sDecl);
+
+        for (auto& sub: sDecl->subdecls) {
+            structs_of(sub.get(), structs);
+        }
+    } else if (decl->kind == Node::Kind::VariantDecl) {
+        for (auto& sub: static_cast<VariantDeclaration*>(decl)->subdecls) {
+            structs_of(sub.get(), structs);
+        }
+    }
+}
+
+// Templates are only laid out instantiated, they are left out
+std::string Layout::report(const std::vector<Declaration*>& decls, const std::string& path) {
+    std::vector<StructDeclaration*> structs;
+    for (Declaration *decl: decls) {
+        structs_of(decl, structs);
+    }
+
+    std::string lines;
+
+    for (StructDeclaration *decl: structs) {
+        if (decl->size < 0 || !decl->templates.empty()) {
+            continue;
+        }
+
+        std::vector<Shape> none;
+        Env env { &decl->templates, &none };
+        bool reordered = reorder || decl->reorder;
+
+        // The other way, from the layouts of the fields laid out already
+        Shape other;
+        if (!fields(decl, &env, !reordered, other)) {
+            continue;
+        }
+
+        std::string line = path + ':' + std::to_string(decl->token.line) + ':' + std::to_string(decl->token.column) + ": " +
+                           decl->name + " is " + std::to_string(decl->size) + " bytes";
+
+        if (reordered) {
+            lines += line + ", " + std::to_string(other.size - decl->size) + " saved by reordering its fields\n";
+        } else if (other.size < decl->size) {
+            lines += line + ", reordering its fields would save " + std::to_string(decl->size - other.size) + "\n";
+        }
+    }
+
+    return lines;
+}
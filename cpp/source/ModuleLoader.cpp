@@ -0,0 +1,1145 @@
+#include <ModuleLoader.hpp>
+#include <Files.hpp>
+#include <Parser.hpp>
+#include <Token_ids.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <direct.h>
+#define getcwd _getcwd
+#endif
+
+// Resolves '.' and '..' segments and repeated slashes, without looking at the file system
+static std::string normalize(const std::string& path) {
+    std::vector<std::string> segments;
+    bool absolute = !path.empty() && path[0] == '/';
+
+    size_t begin = 0;
+    while (begin <= path.size()) {
+        size_t end = path.find('/', begin);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+
+        std::string segment = path.substr(begin, end - begin);
+
+        if (segment == "..") {
+            if (!segments.empty() && segments.back() != "..") {
+                segments.pop_back();
+            } else if (!absolute) {
+                segments.push_back(segment);
+            }
+        } else if (!segment.empty() && segment != ".") {
+            segments.push_back(segment);
+        }
+
+        begin = end + 1;
+    }
+
+    std::string buff = absolute ? "/" : "";
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (i > 0) {
+            buff += '/';
+        }
+
+        buff += segments[i];
+    }
+
+    return buff.empty() ? "." : buff;
+}
+
+// Empty for a path without directory
+static std::string directory_of(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+static std::string join(const std::string& directory, const std::string& path) {
+    if (directory.empty() || directory.back() == '/') {
+        return directory + path;
+    }
+
+    return directory + '/' + path;
+}
+
+static bool exists(const std::string& path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file) {
+        fclose(file);
+    }
+
+    return file != nullptr;
+}
+
+// path from the root of the file system
+static std::string absolute(const std::string& path) {
+    if (!path.empty() && path[0] == '/') {
+        return path;
+    }
+
+    char directory[4096];
+    if (!getcwd(directory, sizeof(directory))) {
+        return path;
+    }
+
+    return normalize(join(directory, path));
+}
+
+static void dump_token_stream(std::ostream& out, const std::vector<Token>& stream) {
+    for (auto& tok: stream) {
+        out << tokNames[tok.id] << ' ';
+    }
+}
+
+static std::string token_dump(Module *module) {
+    std::ostringstream out;
+    out << "Token stream of " << module->path << " (" << module->tokens.size() << " tokens): " << std::endl;
+    dump_token_stream(out, module->tokens);
+    out << std::endl;
+
+    return out.str();
+}
+
+static bool header_token(int id) {
+    return id == USE || id == IMPORT || id == USE_LIB || id == UNIT_PATH || id == WHITESPACE || id == NEWLINE;
+}
+
+// Lexes buffer up to the END or, with header, up to the first token that is not part of a use or an import
+static void lex(const char *buffer, std::vector<Token>& tokens, bool header) {
+    Lexer lexer(buffer);
+
+    Token curr;
+    do {
+        curr = lexer.nextToken();
+        tokens.emplace_back(curr);
+    } while (curr.id != END && (!header || header_token(curr.id)));
+}
+
+// Reads and lexes a whole unit, returns its contents
+static char *lex_unit(FILE *file, std::vector<Token>& tokens) {
+    fseek(file, 0, SEEK_END);
+
+    int length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *buffer = new char[length + 1];
+
+    fread(buffer, 1, length, file);
+    buffer[length] = 0;
+
+    try {
+        lex(buffer, tokens, false);
+    } catch (std::runtime_error&) {
+        delete[] buffer;
+        throw;
+    }
+
+    return buffer;
+}
+
+// Lexes a unit held in a bundle, whole or up to the end of its header as lex_header() does, returns a copy of its contents
+static char *lex_bundled(const char *data, size_t length, std::vector<Token>& tokens, bool header) {
+    char *buffer = new char[length + 1];
+
+    memcpy(buffer, data, length);
+    buffer[length] = 0;
+
+    try {
+        lex(buffer, tokens, header);
+    } catch (std::runtime_error&) {
+        delete[] buffer;
+        throw;
+    }
+
+    if (header) {
+        tokens.back().id = END;
+        tokens.back().length = 0;
+    }
+
+    return buffer;
+}
+
+// Reads and lexes the beginning of a unit up to the first token that is not part of a use or an import,
+// which becomes the END of the stream. Returns the contents read.
+// Chunks of growing size are read from the start until one holds that token whole, or the unit is read entirely.
+static char *lex_header(FILE *file, std::vector<Token>& tokens) {
+    for (size_t size = 4096; ; size *= 2) {
+        char *buffer = new char[size + 1];
+
+        fseek(file, 0, SEEK_SET);
+        size_t length = fread(buffer, 1, size, file);
+        buffer[length] = 0;
+
+        bool whole = length < size;
+        tokens.clear();
+
+        try {
+            lex(buffer, tokens, true);
+        } catch (std::runtime_error&) {
+            // A comment cut by the end of the chunk
+            delete[] buffer;
+
+            if (whole) {
+                throw;
+            }
+
+            continue;
+        }
+
+        Token& last = tokens.back();
+
+        // Also a token touching the end of the chunk may be the beginning of a longer one
+        if (whole || (last.id != END && last.start + last.length < buffer + length)) {
+            last.id = END;
+            last.length = 0;
+            return buffer;
+        }
+
+        delete[] buffer;
+    }
+}
+
+void ModuleLoader::load(const std::vector<std::string>& paths) {
+    std::vector<Module*> fresh;
+
+    {
+        // All the roots are known before any of them is read, so none is mistaken for a mere dependency
+        std::lock_guard<std::mutex> guard(lock);
+
+        for (auto& path: paths) {
+            bool known = by_path.count(normalize(path)) > 0;
+            Module *module = create(normalize(path), true);
+
+            if (!known) {
+                fresh.push_back(module);
+            }
+
+            if (std::find(roots.begin(), roots.end(), module) == roots.end()) {
+                roots.push_back(module);
+            }
+        }
+    }
+
+    for (Module *module: fresh) {
+        pool.submit([this, module]() { read(module); });
+    }
+}
+
+// The module of path, made the first time it is asked for, the lock must be held
+Module *ModuleLoader::create(const std::string& path, bool root) {
+    auto found = by_path.find(path);
+    if (found != by_path.end()) {
+        // Only load() makes roots, before anything is read
+        if (root) {
+            found->second->root = true;
+            found->second->whole = true;
+        }
+
+        return found->second;
+    }
+
+    owned.emplace_back(new Module());
+    Module *module = owned.back().get();
+
+    module->path = path;
+    module->id = 0;
+    module->context = context.fork();
+    module->component = 0;
+    module->root = root;
+    module->whole = root;
+    module->key = 0;
+    module->stamp = { -1, 0, 0 };
+    module->reusable = false;
+    module->unchanged = false;
+    module->surface = 0;
+    module->fingerprint = 0;
+    module->current = false;
+    module->bundle = nullptr;
+    module->source_entry = Bundle::none;
+    module->interface_entry = Bundle::none;
+
+    auto in_bundle = bundled.find(path);
+    if (!root && in_bundle != bundled.end()) {
+        module->bundle = in_bundle->second.bundle;
+        module->source_entry = in_bundle->second.source;
+        module->interface_entry = in_bundle->second.interface;
+    }
+
+    // Bodies are parsed by materialize(), for the declarations importers see
+    if (!root) {
+        module->context->options.lazy_bodies = true;
+    }
+
+    by_path[path] = module;
+    return module;
+}
+
+// The module of a dependency, queued for reading the first time it is asked for
+Module *ModuleLoader::request(const std::string& path) {
+    Module *module;
+    bool known;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        known = by_path.count(path) > 0;
+        module = create(path, false);
+    }
+
+    if (!known) {
+        pool.submit([this, module]() { read(module); });
+    }
+
+    return module;
+}
+
+// Reads, lexes and parses a unit, then requests its dependencies. Problems are reported to its context.
+// With Options::scan_deps only its uses and imports are read.
+// A dependency with an up to date interface is not read at all, the interface stands for it.
+// Otherwise the one the cache has for the contents of the unit does, if any.
+void ModuleLoader::read(Module *module) {
+    if (resident && !context.options.scan_deps && resident->take(module) && context.options.dump_tokens) {
+        module->token_dump = token_dump(module);
+    }
+
+    // What a bundle holds was up to date when it was written, and stays so
+    bool fresh = module->bundle ? module->interface_entry != Bundle::none : Interface::fresh(module->path);
+
+    if (!module->unit && !module->root && fresh) {
+        size_t entry = module->interface_entry;
+        module->interface = module->bundle ? Interface::open(module->bundle->data(entry), module->bundle->length(entry))
+                                           : Interface::open(module->path + 'i');
+
+        try {
+            if (module->interface) {
+                module->unit = module->interface->header(module->path);
+            }
+        } catch (std::runtime_error&) {
+            module->interface.reset();
+        }
+
+        // Otherwise the unit is read instead
+        if (!module->interface && (module->bundle ? module->source_entry == Bundle::none : !exists(module->path))) {
+            module->context->err_handler->report("Could not read interface " + module->path + "i.");
+            return;
+        }
+    }
+
+    // The tokens and the uses and imports alone are not kept in the cache
+    if (!module->interface && cache && !context.options.dump_tokens && !context.options.scan_deps) {
+        lookup(module);
+    }
+
+    if (!module->unit && !parse(module)) {
+        return;
+    }
+
+    for (auto& use: module->unit->uses) {
+        std::string name = use->unit_path.empty() ? use->lib_name + ".sky" : use->lib_name + '/' + use->unit_path + ".sky";
+
+        std::vector<std::string> candidates;
+        for (auto& directory: context.options.library_dirs) {
+            Bundle *bundle = library(directory, use->lib_name);
+
+            if (!bundle) {
+                candidates.push_back(join(directory, name));
+                continue;
+            }
+
+            // The bundle has the whole library, the directory is not looked at
+            Bundled entries { bundle, bundle->find(name), bundle->find(name + 'i') };
+
+            if (entries.source != Bundle::none || entries.interface != Bundle::none) {
+                std::string path = normalize(join(directory, name));
+                candidates.push_back(path);
+
+                std::lock_guard<std::mutex> guard(lock);
+                bundled.emplace(path, entries);
+            }
+        }
+
+        if (Module *dependency = resolve(module, *use, use->lib_name + (use->unit_path.empty() ? "" : '/' + use->unit_path), candidates)) {
+            select(dependency, module, nullptr);
+        }
+    }
+
+    for (auto& import: module->unit->imports) {
+        std::vector<std::string> candidates { join(directory_of(module->path), import->unit_path + ".sky") };
+        for (auto& directory: context.options.import_dirs) {
+            candidates.push_back(join(directory, import->unit_path + ".sky"));
+        }
+
+        if (Module *dependency = resolve(module, *import, import->unit_path, candidates)) {
+            select(dependency, module, import->names.empty() ? nullptr : import.get());
+        }
+    }
+}
+
+// Reads the source of a unit, false if it has no unit to show
+bool ModuleLoader::parse(Module *module) {
+    // Before reading: a change made meanwhile shows in the next stamp
+    module->stamp = FileStamp::of(module->path);
+
+    FILE *file = module->bundle ? nullptr : fopen(module->path.c_str(), "rb");
+
+    if (module->bundle ? module->source_entry == Bundle::none : !file) {
+        module->context->err_handler->report("Could not open unit " + module->path + '.');
+        return false;
+    }
+
+    char *buffer;
+
+    try {
+        if (module->bundle) {
+            size_t entry = module->source_entry;
+            buffer = lex_bundled(module->bundle->data(entry), module->bundle->length(entry), module->tokens, context.options.scan_deps);
+        } else {
+            buffer = context.options.scan_deps ? lex_header(file, module->tokens) : lex_unit(file, module->tokens);
+        }
+    } catch (std::runtime_error& e) {
+        if (file) {
+            fclose(file);
+        }
+
+        module->context->err_handler->report("In unit " + module->path + ": " + e.what());
+        return false;
+    }
+
+    if (file) {
+        fclose(file);
+    }
+
+    // Version pass here.
+    // Evaluates versions, keeps tokens we want
+    // This means version is context free, you can put it anywhere in your code
+    // (just be careful with it please)
+
+    if (context.options.dump_tokens) {
+        module->token_dump = token_dump(module);
+    }
+
+    size_t reports = module->context->buffered();
+
+    Parser parser(*module->context, &module->tokens.front());
+    module->unit = context.options.scan_deps ? parser.header(module->path, buffer) : parser.unit(module->path, buffer);
+
+    // A bundled unit has no file whose changes ResidentUnits could follow
+    module->reusable = module->unit && !module->bundle && !context.options.scan_deps && module->context->buffered() == reports;
+
+    return module->unit != nullptr;
+}
+
+// Computes the key of a unit and, unless it has one already, loads it from the interface the cache has for it
+void ModuleLoader::lookup(Module *module) {
+    FILE *file = module->bundle ? nullptr : fopen(module->path.c_str(), "rb");
+
+    // Reported by parse()
+    if (module->bundle ? module->source_entry == Bundle::none : !file) {
+        return;
+    }
+
+    uint32_t version = Cache::version;
+    uint32_t length = module->path.size();
+
+    uint64_t key = Interface::hash(Interface::hash_basis, &version, sizeof(version));
+    key = Interface::hash(key, &length, sizeof(length));
+    key = Interface::hash(key, module->path.data(), module->path.size());
+
+    if (module->bundle) {
+        key = Interface::hash(key, module->bundle->data(module->source_entry), module->bundle->length(module->source_entry));
+    } else {
+        char buffer[1 << 16];
+        size_t read;
+
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            key = Interface::hash(key, buffer, read);
+        }
+
+        bool ok = !ferror(file);
+        fclose(file);
+
+        if (!ok) {
+            return;
+        }
+    }
+
+    module->key = key;
+
+    if (module->unit || !cache->has(key, "skyi")) {
+        return;
+    }
+
+    module->interface = Interface::open(cache->path(key, "skyi"));
+
+    try {
+        if (module->interface) {
+            module->unit = module->interface->header(module->path);
+        }
+    } catch (std::runtime_error&) {
+        module->interface.reset();
+    }
+}
+
+// The bundle of library lib in directory, opened the first time it is asked for, nullptr when there is none
+Bundle *ModuleLoader::library(const std::string& directory, const std::string& lib) {
+    std::string path = normalize(join(directory, lib + ".skyb"));
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        auto found = bundles.find(path);
+        if (found != bundles.end()) {
+            return found->second.get();
+        }
+    }
+
+    // Opened without the lock, the first one in is kept
+    auto bundle = Bundle::open(path);
+
+    std::lock_guard<std::mutex> guard(lock);
+    return bundles.emplace(path, std::move(bundle)).first->second.get();
+}
+
+bool ModuleLoader::bundle(const std::string& path) {
+    std::string directory = directory_of(path);
+    std::string base = normalize(directory.empty() ? "." : directory);
+
+    std::string lib = path.substr(directory.size());
+    lib = lib.substr(0, lib.rfind('.'));
+
+    std::vector<std::pair<std::string, std::string>> entries;
+    bool ok = true;
+
+    for (Module *module: roots) {
+        // Named from the library directory
+        std::string name = module->path;
+        if (base != ".") {
+            name = name.compare(0, base.size() + 1, base + '/') == 0 ? name.substr(base.size() + 1) : "";
+        }
+
+        if (name != lib + ".sky" && name.compare(0, lib.size() + 1, lib + '/') != 0) {
+            context.err_handler->report("Unit " + module->path + " is not part of library " + lib + " of " + path + '.');
+            ok = false;
+            continue;
+        }
+
+        entries.emplace_back(name, module->path);
+
+        if (Interface::fresh(module->path)) {
+            entries.emplace_back(name + 'i', module->path + 'i');
+        }
+    }
+
+    if (ok && !Bundle::write(entries, path)) {
+        context.err_handler->report("Could not write bundle " + path + '.');
+        ok = false;
+    }
+
+    return ok;
+}
+
+bool ModuleLoader::reparse(Module *module) {
+    module->header = std::move(module->unit);
+    return parse(module);
+}
+
+// Records what importer wants of dependency: the declarations import lists, or everything when it is nullptr
+void ModuleLoader::select(Module *dependency, Module *importer, Import *import) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (import) {
+        dependency->selections.push_back({ importer, import });
+    } else {
+        dependency->whole = true;
+    }
+}
+
+// First candidate that is already loaded, in a bundle or exists on disk (or its interface does), becomes a dependency of module
+Module *ModuleLoader::resolve(Module *module, const Node& node, const std::string& name, const std::vector<std::string>& candidates) {
+    for (auto& candidate: candidates) {
+        std::string path = normalize(candidate);
+
+        bool known;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            known = by_path.count(path) > 0 || bundled.count(path) > 0;
+        }
+
+        if (known || exists(path) || exists(path + 'i')) {
+            Module *dependency = request(path);
+
+            if (std::find(module->dependencies.begin(), module->dependencies.end(), dependency) == module->dependencies.end()) {
+                module->dependencies.push_back(dependency);
+            }
+
+            return dependency;
+        }
+    }
+
+    module->context->err_handler->report(module->unit.get(), node.token, "Could not find unit " + name + '.');
+    return nullptr;
+}
+
+std::vector<Module*>& ModuleLoader::modules() {
+    pool.wait();
+
+    if (!loaded) {
+        ordered = roots;
+
+        std::vector<Module*> others;
+        for (auto& module: owned) {
+            if (!module->root) {
+                others.push_back(module.get());
+            }
+        }
+
+        std::sort(others.begin(), others.end(), [](const Module *a, const Module *b) { return a->path < b->path; });
+        ordered.insert(ordered.end(), others.begin(), others.end());
+
+        for (size_t i = 0; i < ordered.size(); ++i) {
+            ordered[i]->id = i;
+        }
+
+        if (!context.options.scan_deps) {
+            std::vector<std::vector<std::pair<Module::Selection, std::string>>> missing(ordered.size());
+
+            for (Module *module: ordered) {
+                std::sort(module->selections.begin(), module->selections.end(), [](const Module::Selection& a, const Module::Selection& b) {
+                    return a.importer->id != b.importer->id ? a.importer->id < b.importer->id : a.import->token.start < b.import->token.start;
+                });
+
+                pool.submit([this, module, &missing]() {
+                    materialize(module, missing[module->id]);
+                    module->exports.reset(new Exports(module->visible));
+                });
+            }
+
+            pool.wait();
+
+            // Reported against the importers, from this thread as their contexts are not the materialized modules'
+            for (size_t i = 0; i < ordered.size(); ++i) {
+                for (auto& name: missing[i]) {
+                    Module *importer = name.first.importer;
+                    importer->context->err_handler->report(importer->unit.get(), name.first.import->token,
+                                                           "Unit " + ordered[i]->path + " has no declaration named " + name.second + '.');
+                }
+            }
+        }
+
+        loaded = true;
+    }
+
+    return ordered;
+}
+
+// Finds the top-level declarations importers see and, unless the unit is a root, parses the function bodies in them.
+// Selected names the unit does not declare are left in missing.
+void ModuleLoader::materialize(Module *module, std::vector<std::pair<Module::Selection, std::string>>& missing) {
+    Unit *unit = module->unit.get();
+
+    if (!unit) {
+        return;
+    }
+
+    if (module->interface) {
+        materialize_interface(module, missing);
+        return;
+    }
+
+    std::unordered_map<std::string, std::vector<size_t>> by_name;
+    for (size_t i = 0; i < unit->decls.size(); ++i) {
+        by_name[declaration_name(unit->decls[i].get())].push_back(i);
+    }
+
+    // Names each top-level declaration refers to and its functions whose body was skipped, read from the unit's index.
+    // Nodes of the bodies parsed meanwhile are added at the end of the index.
+    const Node::Kind kinds[] = { Node::Kind::BaseType, Node::Kind::VariableAcc, Node::Kind::FuncDecl };
+    size_t seen[3] = { 0, 0, 0 };
+
+    std::unordered_map<uint32_t, std::vector<std::string>> references;
+    std::unordered_map<uint32_t, std::vector<FunctionDeclaration*>> pending;
+
+    auto collect = [&]() {
+        for (size_t k = 0; k < 3; ++k) {
+            auto& nodes = unit->nodes(kinds[k]);
+            auto& owners = unit->owners(kinds[k]);
+
+            for (; seen[k] < nodes.size(); ++seen[k]) {
+                Node *node = nodes[seen[k]];
+
+                if (node->kind == Node::Kind::FuncDecl) {
+                    auto fDecl = static_cast<FunctionDeclaration*>(node);
+                    if (fDecl->body_pending()) {
+                        pending[owners[seen[k]]].push_back(fDecl);
+                    }
+
+                    continue;
+                }
+
+                // a::b refers to the top-level a
+                const std::string& name = node->kind == Node::Kind::BaseType ? static_cast<BaseType*>(node)->name
+                                                                             : static_cast<VariableAccess*>(node)->name;
+                references[owners[seen[k]]].push_back(name.substr(0, name.find("::")));
+            }
+        }
+    };
+
+    collect();
+
+    std::vector<bool> visible(unit->decls.size(), false);
+    std::vector<size_t> queue;
+
+    auto want = [&](const std::string& name) -> bool {
+        auto found = by_name.find(name);
+        if (found == by_name.end() || name.empty()) {
+            return false;
+        }
+
+        for (size_t i: found->second) {
+            if (!visible[i]) {
+                visible[i] = true;
+                queue.push_back(i);
+            }
+        }
+
+        return true;
+    };
+
+    if (module->whole) {
+        for (size_t i = 0; i < unit->decls.size(); ++i) {
+            visible[i] = true;
+            queue.push_back(i);
+        }
+    }
+
+    for (auto& selection: module->selections) {
+        for (auto& name: selection.import->names) {
+            if (!want(name)) {
+                missing.push_back({ selection, name });
+            }
+        }
+    }
+
+    while (!queue.empty()) {
+        uint32_t owner = unit->spans[queue.back()].owner;
+        queue.pop_back();
+
+        // Roots keep the bodies their options say, lazy ones are parsed when asked for
+        if (!module->root) {
+            while (!pending[owner].empty()) {
+                FunctionDeclaration *fDecl = pending[owner].back();
+                pending[owner].pop_back();
+
+                Parser::body(fDecl);
+                collect();
+            }
+        }
+
+        for (auto& name: references[owner]) {
+            want(name);
+        }
+    }
+
+    for (size_t i = 0; i < unit->decls.size(); ++i) {
+        if (visible[i]) {
+            module->visible.push_back(unit->decls[i].get());
+        }
+    }
+}
+
+// Tarjan's strongly connected components, on an explicit stack: import chains can be thousands of units long.
+// Components come out dependencies first.
+void ModuleLoader::link() {
+    auto& nodes = modules();
+
+    const size_t unvisited = static_cast<size_t>(-1);
+    std::vector<size_t> index(nodes.size(), unvisited);
+    std::vector<size_t> low(nodes.size(), 0);
+    std::vector<bool> on_stack(nodes.size(), false);
+
+    std::vector<size_t> stack;
+    size_t counter = 0;
+
+    struct Frame {
+        size_t node;
+        size_t next;
+    };
+
+    std::vector<Frame> frames;
+
+    auto visit = [&](size_t node) {
+        index[node] = low[node] = counter++;
+        stack.push_back(node);
+        on_stack[node] = true;
+        frames.push_back({ node, 0 });
+    };
+
+    for (size_t root = 0; root < nodes.size(); ++root) {
+        if (index[root] != unvisited) {
+            continue;
+        }
+
+        visit(root);
+
+        while (!frames.empty()) {
+            Frame& frame = frames.back();
+            size_t node = frame.node;
+            auto& dependencies = nodes[node]->dependencies;
+
+            if (frame.next < dependencies.size()) {
+                size_t next = dependencies[frame.next++]->id;
+
+                if (index[next] == unvisited) {
+                    visit(next);
+                } else if (on_stack[next]) {
+                    low[node] = std::min(low[node], index[next]);
+                }
+
+                continue;
+            }
+
+            frames.pop_back();
+            if (!frames.empty()) {
+                size_t parent = frames.back().node;
+                low[parent] = std::min(low[parent], low[node]);
+            }
+
+            if (low[node] == index[node]) {
+                components.emplace_back();
+
+                size_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    on_stack[member] = false;
+
+                    nodes[member]->component = components.size() - 1;
+                    components.back().push_back(nodes[member]);
+                } while (member != node);
+
+                std::sort(components.back().begin(), components.back().end(), [](const Module *a, const Module *b) { return a->id < b->id; });
+            }
+        }
+    }
+
+    linked = true;
+}
+
+void ModuleLoader::schedule(const std::function<void(std::vector<Module*>&)>& pass) {
+    if (!linked) {
+        link();
+    }
+
+    // Components each one waits for, and those waiting for it
+    std::unique_ptr<std::atomic<size_t>[]> waiting(new std::atomic<size_t>[components.size()]);
+    std::vector<std::vector<size_t>> dependents(components.size());
+
+    for (size_t i = 0; i < components.size(); ++i) {
+        std::vector<size_t> dependencies;
+
+        for (Module *module: components[i]) {
+            for (Module *dependency: module->dependencies) {
+                if (dependency->component != i) {
+                    dependencies.push_back(dependency->component);
+                }
+            }
+        }
+
+        std::sort(dependencies.begin(), dependencies.end());
+        dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+
+        waiting[i] = dependencies.size();
+        for (size_t dependency: dependencies) {
+            dependents[dependency].push_back(i);
+        }
+    }
+
+    std::function<void(size_t)> run = [&](size_t component) {
+        pass(components[component]);
+
+        for (size_t dependent: dependents[component]) {
+            if (--waiting[dependent] == 0) {
+                pool.submit([&run, dependent]() { run(dependent); });
+            }
+        }
+    };
+
+    // Picked before submitting: the first groups could otherwise release others while the counters are read
+    std::vector<size_t> ready;
+    for (size_t i = 0; i < components.size(); ++i) {
+        if (waiting[i] == 0) {
+            ready.push_back(i);
+        }
+    }
+
+    for (size_t i: ready) {
+        pool.submit([&run, i]() { run(i); });
+    }
+
+    pool.wait();
+}
+
+// Same as materialize() with the references the interface keeps, the declarations it builds are the visible ones
+void ModuleLoader::materialize_interface(Module *module, std::vector<std::pair<Module::Selection, std::string>>& missing) {
+    Interface& interface = *module->interface;
+
+    std::vector<bool> visible(interface.size(), false);
+    std::vector<size_t> queue;
+
+    auto want = [&](const std::string& name) -> bool {
+        auto found = interface.find(name);
+
+        for (size_t i: found) {
+            if (!visible[i]) {
+                visible[i] = true;
+                queue.push_back(i);
+            }
+        }
+
+        return !found.empty() && !name.empty();
+    };
+
+    try {
+        if (module->whole) {
+            for (size_t i = 0; i < interface.size(); ++i) {
+                visible[i] = true;
+            }
+        }
+
+        for (auto& selection: module->selections) {
+            for (auto& name: selection.import->names) {
+                if (!want(name)) {
+                    missing.push_back({ selection, name });
+                }
+            }
+        }
+
+        while (!queue.empty()) {
+            size_t i = queue.back();
+            queue.pop_back();
+
+            for (auto& name: interface.references(i)) {
+                want(name);
+            }
+        }
+
+        for (size_t i = 0; i < interface.size(); ++i) {
+            if (visible[i]) {
+                module->visible.push_back(interface.declaration(i));
+            }
+        }
+    } catch (std::runtime_error& e) {
+        module->visible.clear();
+        module->context->err_handler->report("In interface " + module->path + "i: " + e.what());
+    }
+}
+
+// The units of a group share a fingerprint: a hash of the options, of their paths and surfaces and of the fingerprints of
+// the units outside the group they depend on. An implementation change leaves it as it was, a change of what a unit exports
+// or of how it is laid out changes it and, through theirs, the fingerprints of every unit depending on it.
+// The group is current when each of its units has an up to date interface that recorded the same fingerprints.
+void ModuleLoader::fingerprint(std::vector<Module*>& group, uint64_t options) {
+    bool current = true;
+
+    // Fingerprints the interfaces of the units were written with
+    std::vector<uint64_t> recorded_fingerprints;
+
+    std::vector<Interface::Dependency> members;
+    std::vector<Interface::Dependency> outside;
+
+    auto path_order = [](const Interface::Dependency& a, const Interface::Dependency& b) { return a.path < b.path; };
+    auto same = [](const Interface::Dependency& a, const Interface::Dependency& b) { return a.path == b.path && a.fingerprint == b.fingerprint; };
+
+    for (Module *module: group) {
+        module->outside.clear();
+
+        for (Module *dependency: module->dependencies) {
+            if (dependency->component != module->component) {
+                module->outside.push_back({ dependency->path, dependency->fingerprint });
+            }
+        }
+
+        std::sort(module->outside.begin(), module->outside.end(), path_order);
+        outside.insert(outside.end(), module->outside.begin(), module->outside.end());
+
+        // The interface of a root is the one it is compiled to, whatever it was loaded from
+        Interface *interface = module->root ? nullptr : module->interface.get();
+        std::unique_ptr<Interface> written;
+
+        if (module->root && Interface::fresh(module->path)) {
+            written = Interface::open(module->path + 'i');
+            interface = written.get();
+        }
+
+        try {
+            auto recorded = interface ? interface->dependencies() : std::vector<Interface::Dependency>();
+            current = current && interface && std::equal(recorded.begin(), recorded.end(), module->outside.begin(), module->outside.end(), same);
+        } catch (std::runtime_error&) {
+            current = false;
+        }
+
+        if (current) {
+            recorded_fingerprints.push_back(interface->fingerprint());
+        }
+
+        if (module->interface) {
+            module->surface = module->interface->surface();
+        } else if (module->unit) {
+            module->surface = Interface::surface(module->unit.get());
+        }
+
+        members.push_back({ module->path, module->surface });
+    }
+
+    std::sort(members.begin(), members.end(), path_order);
+    std::sort(outside.begin(), outside.end(), path_order);
+    outside.erase(std::unique(outside.begin(), outside.end(), same), outside.end());
+
+    uint64_t fingerprint = Interface::hash(Interface::hash_basis, &options, sizeof(options));
+
+    for (auto* list: { &members, &outside }) {
+        for (auto& entry: *list) {
+            uint32_t length = entry.path.size();
+
+            fingerprint = Interface::hash(fingerprint, &length, sizeof(length));
+            fingerprint = Interface::hash(fingerprint, entry.path.data(), entry.path.size());
+            fingerprint = Interface::hash(fingerprint, &entry.fingerprint, sizeof(entry.fingerprint));
+        }
+    }
+
+    for (uint64_t recorded: recorded_fingerprints) {
+        current = current && recorded == fingerprint;
+    }
+
+    for (Module *module: group) {
+        module->fingerprint = fingerprint;
+        module->current = current;
+    }
+}
+
+FileStamp FileStamp::of(const std::string& path) {
+    struct stat info;
+    long long now = time(nullptr);
+
+    if (stat(path.c_str(), &info) != 0) {
+        return { -1, 0, now };
+    }
+
+    return { static_cast<long long>(info.st_size), static_cast<long long>(info.st_mtime), now };
+}
+
+bool ResidentUnits::take(Module *module) {
+    Entry entry;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        auto found = entries.find(absolute(module->path));
+        if (found == entries.end()) {
+            return false;
+        }
+
+        // Given once, kept again with what becomes of it
+        entry = std::move(found->second);
+        entries.erase(found);
+    }
+
+    auto& options = module->context->options;
+
+    if (entry.lazy_bodies != options.lazy_bodies || entry.recover_errors != options.recover_errors
+        || entry.explicit_stack != options.explicit_stack || entry.max_nesting_depth != options.max_nesting_depth) {
+        return false;
+    }
+
+    FileStamp stamp = FileStamp::of(module->path);
+    bool unchanged = true;
+
+    if (!entry.stamp.same(stamp)) {
+        std::string contents;
+        if (!read_file(module->path, contents)) {
+            return false;
+        }
+
+        const char *old = entry.unit->contents;
+        size_t old_length = entry.unit->contents_length(entry.tokens);
+        size_t shortest = std::min(old_length, contents.size());
+
+        size_t prefix = 0;
+        while (prefix < shortest && old[prefix] == contents[prefix]) {
+            prefix++;
+        }
+
+        size_t suffix = 0;
+        while (suffix < shortest - prefix && old[old_length - 1 - suffix] == contents[contents.size() - 1 - suffix]) {
+            suffix++;
+        }
+
+        if (prefix != old_length || old_length != contents.size()) {
+            // The unit is only taken back when it parses without reports, they are made in a context of their own
+            ErrorBuffer reports;
+            CompilationContext scratch(options, &reports);
+
+            TextEdit edit { prefix, old_length - prefix - suffix, contents.substr(prefix, contents.size() - prefix - suffix) };
+            entry.unit->context = &scratch;
+            unchanged = false;
+
+            try {
+                if (!Parser::reparse(scratch, entry.unit, entry.tokens, { edit }) || reports.size() > 0) {
+                    return false;
+                }
+            } catch (std::runtime_error&) {
+                return false;
+            }
+        }
+    }
+
+    module->tokens = std::move(entry.tokens);
+    module->unit = std::move(entry.unit);
+    module->unit->context = module->context.get();
+    module->stamp = stamp;
+    module->reusable = true;
+    module->unchanged = unchanged;
+
+    return true;
+}
+
+void ResidentUnits::keep(const std::vector<Module*>& modules) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (Module *module: modules) {
+        if (!module->reusable) {
+            continue;
+        }
+
+        auto& options = module->context->options;
+        Entry& entry = entries[absolute(module->path)];
+
+        entry.stamp = module->stamp;
+        entry.lazy_bodies = options.lazy_bodies;
+        entry.recover_errors = options.recover_errors;
+        entry.explicit_stack = options.explicit_stack;
+        entry.max_nesting_depth = options.max_nesting_depth;
+        entry.tokens = std::move(module->tokens);
+        entry.unit = std::move(module->unit);
+
+        // Its context goes away with the module, the next one is given by take()
+        entry.unit->context = nullptr;
+        module->reusable = false;
+    }
+}
+
+void ModuleLoader::merge() {
+    for (Module *module: modules()) {
+        context.merge(*module->context);
+    }
+}
@@ -0,0 +1,48 @@
+#include <Names.hpp>
+
+// Slot of name in slots: the one with its id, or the empty one it would go in
+size_t Names::probe(const std::string& name, uint64_t hash) const {
+    size_t mask = slots.size() - 1;
+
+    for (size_t at = hash & mask; ; at = (at + 1) & mask) {
+        uint32_t id = slots[at];
+
+        if (!id || (hashes[id - 1] == hash && names[id - 1] == name)) {
+            return at;
+        }
+    }
+}
+
+uint32_t Names::intern(const std::string& name, uint64_t hash) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    // Kept under half full
+    if ((names.size() + 1) * 2 > slots.size()) {
+        std::vector<uint32_t> grown(slots.empty() ? 64 : slots.size() * 2, 0);
+        slots.swap(grown);
+
+        for (size_t i = 0; i < names.size(); ++i) {
+            slots[probe(names[i], hashes[i])] = i + 1;
+        }
+    }
+
+    size_t at = probe(name, hash);
+
+    if (!slots[at]) {
+        names.push_back(name);
+        hashes.push_back(hash);
+        slots[at] = names.size();
+    }
+
+    return slots[at];
+}
+
+uint32_t Names::find(const std::string& name, uint64_t hash) const {
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (slots.empty()) {
+        return 0;
+    }
+
+    return slots[probe(name, hash)];
+}
@@ -8,6 +8,35 @@ bool void_type(Type *type) {
     return !type || type->isVoid();
 }
 
+bool builtin_layout(const std::string& name, int& size, int& alignment) {
+    static const struct {
+        const char *name;
+        int size;
+        int alignment;
+    } builtins[] = {
+        { "void", 0, 1 }, { "bool", 1, 1 }, { "byte", 1, 1 },
+        { "int8", 1, 1 }, { "int16", 2, 2 }, { "int32", 4, 4 }, { "int64", 8, 8 },
+        { "uint8", 1, 1 }, { "uint16", 2, 2 }, { "uint32", 4, 4 }, { "uint64", 8, 8 },
+        { "float16", 2, 2 }, { "float32", 4, 4 }, { "float64", 8, 8 },
+        // Pointer and length, like an array
+        { "string", 16, 8 },
+    };
+
+    for (auto& builtin: builtins) {
+        if (name == builtin.name) {
+            size = builtin.size;
+            alignment = builtin.alignment;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int align_up(int offset, int alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
 char char_toupper(char c) {
     if (c >= 'a' && c <= 'z') {
         return 'A' + c - 'a';
@@ -1,23 +1,70 @@
 #include <Parser.hpp>
 #include <Token_ids.hpp>
 
-#include <Options.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstddef>
+#include <exception>
+#include <thread>
 
 // This is a handwritten parser subject to tonnes of modification.
 // Its performance is probably horrible.
 
-Parser::Parser(Token *_stream) : stream(_stream), cursor(stream), curr_unit(nullptr) {}
+Parser::Parser(CompilationContext& _context, Token *_stream) : stream(_stream), cursor(stream), curr_unit(nullptr), owner(0), context(&_context),
+                                                                explicit_stack(_context.options.explicit_stack), max_depth(_context.options.max_nesting_depth),
+                                                                lazy_bodies(_context.options.lazy_bodies), jobs(_context.options.parse_jobs),
+                                                                recover(_context.options.recover_errors), err_handler(_context.err_handler), depth(0) {}
+
+// Tracks the nesting of productions that recurse on the C++ stack, see too_deep()
+struct Parser::Nesting {
+    Nesting (Parser *_parser) : parser(_parser) {
+        parser->depth++;
+    }
+
+    ~Nesting () {
+        parser->depth--;
+    }
+
+    Parser *parser;
+};
+
+bool Parser::too_deep() {
+    if (depth <= max_depth) {
+        return false;
+    }
+
+    raise(*cursor, "Nesting is too deep, the limit is " + std::to_string(max_depth) + " levels.");
+    return true;
+}
 
 inline bool Parser::accept(int id) {
     return (cursor++)->id == id;
 }
 
+// Errors unwind to the nearest point parsing can go on from: a statement or declaration in recover mode, else the unit
 void Parser::raise(const std::string& message, ErrorLevel level) {
-    Options::get().err_handler->report(message, level);
+    err_handler->report(message, level);
+
+    if (level == ErrorLevel::Error) {
+        throw Recovery { message };
+    }
 }
 
 void Parser::raise(const Token& token, const std::string& message, ErrorLevel level) {
-    Options::get().err_handler->report(curr_unit, token, message, level);
+    err_handler->report(curr_unit, token, message, level);
+
+    if (level == ErrorLevel::Error) {
+        throw Recovery { message };
+    }
+}
+
+void Parser::raise(const Token& token, const char *message, ErrorLevel level) {
+    err_handler->report(curr_unit, token, message, level);
+
+    if (level == ErrorLevel::Error) {
+        throw Recovery { message };
+    }
 }
 
 // Convenience function to auto-rewinding if the accept fails
@@ -46,6 +93,7 @@ inline bool Parser::consumeAll(int id) {
 // Parses a code unit (file)
 std::unique_ptr<Unit> Parser::unit(std::string path, char *contents) {
     auto unit = std::make_unique<Unit>(path, contents);
+    unit->context = context;
 
     curr_unit = unit.get();
 
@@ -55,20 +103,44 @@ std::unique_ptr<Unit> Parser::unit(std::string path, char *contents) {
 
     // unit <- (Use | Import | Newline | Whitespace)* (Declaration | Newline | Whitespace)* END
 
-    while (unit->addUse(use()) || unit->addImport(import()) || accept_rewind(NEWLINE) || accept_rewind(WHITESPACE)) { accepted = cursor; }
-    cursor = accepted;
+    try {
+        while (unit->addUse(use()) || unit->addImport(import()) || accept_rewind(NEWLINE) || accept_rewind(WHITESPACE)) { accepted = cursor; }
+        cursor = accepted;
 
-    while (unit->addDeclaration(declaration()) || accept_rewind(NEWLINE) || accept_rewind(WHITESPACE)) { accepted = cursor; }
-    cursor = accepted;
+        if (jobs <= 1 || !parallel_declarations(unit.get())) {
+            while (top_level_declaration(unit.get()) || accept_rewind(NEWLINE) || accept_rewind(WHITESPACE)) { accepted = cursor; }
+            cursor = accepted;
+        }
 
-    if (!accept_rewind(END)) {
-        raise(*cursor, "Unexpected token at the end of input.");
+        if (!accept_rewind(END)) {
+            raise(*cursor, "Unexpected token at the end of input.");
+            return nullptr;
+        }
+    } catch (Recovery&) {
+        // The unit takes its contents along
+        err_handler->detach(unit.get());
         return nullptr;
     }
 
     return unit;
 }
 
+std::unique_ptr<Unit> Parser::header(std::string path, char *contents) {
+    auto unit = std::make_unique<Unit>(path, contents);
+    unit->context = context;
+
+    curr_unit = unit.get();
+
+    Token *accepted = cursor;
+
+    // header <- (Use | Import | Newline | Whitespace)*
+
+    while (unit->addUse(use()) || unit->addImport(import()) || accept_rewind(NEWLINE) || accept_rewind(WHITESPACE)) { accepted = cursor; }
+    cursor = accepted;
+
+    return unit;
+}
+
 inline Declaration *Parser::declaration() {
     // declaration <- functionDecl | variableDecl | structDecl | dataDecl | aliasDecl | namespaceDecl
     // Try namespace first, then inf-ass variabledecl, then the rest?
@@ -87,6 +159,493 @@ inline Declaration *Parser::declaration() {
     }
 }
 
+// Parses a declaration at the top level of unit, recording the tokens it spans
+inline bool Parser::top_level_declaration(Unit *unit) {
+    Token *start = cursor;
+    owner = unit->new_owner();
+
+    Declaration *decl;
+
+    if (!recover) {
+        decl = declaration();
+    } else {
+        // Nodes of a failed declaration may already be freed
+        auto mark = unit->index_mark();
+
+        try {
+            decl = declaration();
+
+            if (!decl && cursor->id != WHITESPACE && cursor->id != NEWLINE && cursor->id != END) {
+                raise(*cursor, "Expected declaration.");
+            }
+        } catch (Recovery& recovery) {
+            if (err_handler->saturated()) {
+                throw;
+            }
+
+            unit->forget(mark);
+
+            cursor = start;
+            skip_declaration();
+            decl = syntax_error(start, recovery.message);
+        }
+    }
+
+    if (!unit->addDeclaration(decl)) {
+        return false;
+    }
+
+    unit->spans.push_back({ static_cast<size_t>(start - stream), static_cast<size_t>(cursor - stream), owner });
+    return true;
+}
+
+// Splices the declarations of a unit parsed separately in unit, before decls[at]
+void Parser::adopt(Unit *unit, Unit& piece, size_t at) {
+    std::vector<Node*> funcs = piece.nodes(Node::Kind::FuncDecl);
+    uint32_t offset = unit->splice(piece, at);
+
+    // Skipped bodies are parsed against the real unit, as part of the same declaration
+    for (Node *node: funcs) {
+        auto fDecl = static_cast<FunctionDeclaration*>(node);
+        if (fDecl->body_unit) {
+            fDecl->body_unit = unit;
+            fDecl->body_owner += offset;
+        }
+    }
+}
+
+// Whether tok looks like the start of a top-level declaration: an identifier followed by a colon (or :=) or a namespace keyword
+bool Parser::declaration_start(Token *tok) {
+    Token *next = tok + 1;
+    while (next->id == WHITESPACE) {
+        next++;
+    }
+
+    return (tok->id == IDENTIFIER && (next->id == COLON || next->id == OP_INF_ASS)) || tok->id == NAMESPACE;
+}
+
+// Error recovery at the top level: skips at least a token, up to the next line starting a declaration outside of brackets
+void Parser::skip_declaration() {
+    int nesting = 0;
+    bool line_start = false;
+
+    for (Token *start = cursor; cursor->id != END; ++cursor) {
+        if (cursor != start && nesting == 0 && line_start && declaration_start(cursor)) {
+            break;
+        }
+
+        if (cursor->id == CURLY_OPEN || cursor->id == PAREN_OPEN || cursor->id == BRACK_OPEN) {
+            nesting++;
+        } else if ((cursor->id == CURLY_CLOSE || cursor->id == PAREN_CLOSE || cursor->id == BRACK_CLOSE) && nesting > 0) {
+            nesting--;
+        }
+
+        if (cursor->id == NEWLINE) {
+            line_start = true;
+        } else if (cursor->id != WHITESPACE) {
+            line_start = false;
+        }
+    }
+}
+
+// Error recovery in a scope: skips up to the next statement separator or closing curly brace outside of nested scopes.
+// Only curly braces are matched, an unclosed parenthesis must not swallow the rest of the scope.
+void Parser::skip_statement() {
+    int nesting = 0;
+
+    for (; cursor->id != END; ++cursor) {
+        if (nesting == 0 && (cursor->id == NEWLINE || cursor->id == SEMICOLON || cursor->id == CURLY_CLOSE)) {
+            break;
+        }
+
+        if (cursor->id == CURLY_OPEN) {
+            nesting++;
+        } else if (cursor->id == CURLY_CLOSE) {
+            nesting--;
+        }
+    }
+}
+
+// Spans the tokens skipped since start
+SyntaxError *Parser::syntax_error(Token *start, const std::string& message) {
+    return make<SyntaxError>(cursor > start ? Token::concat(start, last()) : *start, message);
+}
+
+// Pre-scan for parallel_declarations: tokens starting a top-level declaration, that is an identifier followed by a
+// colon (or :=) or a namespace keyword, at the start of a line and outside of any brackets.
+// The first bound is the cursor, the last one the END token.
+std::vector<Token*> Parser::declaration_bounds() {
+    std::vector<Token*> bounds { cursor };
+
+    int nesting = 0;
+    bool line_start = true;
+
+    Token *tok = cursor;
+    for (; tok->id != END; ++tok) {
+        if (tok->id == CURLY_OPEN || tok->id == PAREN_OPEN || tok->id == BRACK_OPEN) {
+            nesting++;
+        } else if (tok->id == CURLY_CLOSE || tok->id == PAREN_CLOSE || tok->id == BRACK_CLOSE) {
+            nesting--;
+        } else if (nesting == 0 && line_start && tok != cursor && declaration_start(tok)) {
+            bounds.push_back(tok);
+        }
+
+        if (tok->id == NEWLINE) {
+            line_start = true;
+        } else if (tok->id != WHITESPACE) {
+            line_start = false;
+        }
+    }
+
+    bounds.push_back(tok);
+    return bounds;
+}
+
+// Parses the top-level declarations on `jobs` threads.
+// The unit is cut at the declaration bounds into a few pieces per thread, every piece is parsed into a unit of its own
+// with its diagnostics buffered, then the diagnostics are replayed and the pieces spliced into the unit in source order.
+// Returns false without touching the unit nor the cursor if a declaration crosses a bound, the caller parses sequentially then.
+bool Parser::parallel_declarations(Unit *unit) {
+    std::vector<Token*> bounds = declaration_bounds();
+    if (bounds.size() < 3) {
+        return false;
+    }
+
+    struct Piece {
+        Token *begin;
+        Token *end;
+
+        // Where the declarations stopped, end if they did not stop early
+        Token *stop;
+
+        std::unique_ptr<Unit> unit;
+        std::unique_ptr<CompilationContext> context;
+        std::exception_ptr exception;
+    };
+
+    // Group the bounds into pieces of about the same number of tokens
+    size_t piece_count = std::min(bounds.size() - 1, static_cast<size_t>(jobs) * 4);
+    size_t piece_tokens = (bounds.back() - bounds.front()) / piece_count + 1;
+
+    std::vector<Piece> pieces;
+    for (size_t i = 0; i < bounds.size() - 1;) {
+        size_t j = i + 1;
+        while (j < bounds.size() - 1 && static_cast<size_t>(bounds[j] - bounds[i]) < piece_tokens) {
+            j++;
+        }
+
+        pieces.emplace_back();
+        pieces.back().begin = bounds[i];
+        pieces.back().end = bounds[j];
+        pieces.back().stop = nullptr;
+        pieces.back().unit = std::make_unique<Unit>(unit->unit_path, nullptr);
+        pieces.back().context = context->fork();
+
+        i = j;
+    }
+
+    std::atomic<size_t> next(0);
+
+    auto work = [&]() {
+        size_t i;
+        while ((i = next++) < pieces.size()) {
+            Piece& piece = pieces[i];
+
+            Parser parser(*piece.context, piece.begin);
+            parser.stream = stream;
+            parser.curr_unit = piece.unit.get();
+
+            try {
+                Token *accepted = parser.cursor;
+                while (parser.cursor < piece.end && (parser.top_level_declaration(piece.unit.get()) ||
+                       parser.accept_rewind(NEWLINE) || parser.accept_rewind(WHITESPACE))) {
+                    accepted = parser.cursor;
+                }
+
+                piece.stop = accepted;
+            } catch (...) {
+                piece.exception = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < jobs && static_cast<size_t>(i) < pieces.size(); ++i) {
+        threads.emplace_back(work);
+    }
+
+    work();
+
+    for (auto& thread: threads) {
+        thread.join();
+    }
+
+    // A declaration ran over the next bound before the sequential parse would have stopped, the split was wrong
+    for (auto& piece: pieces) {
+        if (piece.exception || piece.stop > piece.end) {
+            return false;
+        }
+
+        if (piece.stop < piece.end) {
+            break;
+        }
+    }
+
+    for (auto& piece: pieces) {
+        context->merge(*piece.context, unit);
+
+        adopt(unit, *piece.unit, unit->decls.size());
+        cursor = piece.stop;
+
+        if (piece.stop < piece.end) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool Parser::reparse(CompilationContext& context, std::unique_ptr<Unit>& unit, std::vector<Token>& tokens, std::vector<TextEdit> edits) {
+    if (edits.empty()) {
+        return true;
+    }
+
+    std::sort(edits.begin(), edits.end(), [](const TextEdit& a, const TextEdit& b) { return a.offset < b.offset; });
+
+    char *old_contents = unit->contents;
+    size_t old_length = unit->contents_length(tokens);
+
+    size_t damage_begin = edits.front().offset;
+    size_t damage_end = 0;
+    size_t new_length = old_length;
+
+    for (size_t i = 0; i < edits.size(); ++i) {
+        if (edits[i].offset + edits[i].length > old_length || (i > 0 && edits[i].offset < edits[i - 1].offset + edits[i - 1].length)) {
+            throw std::runtime_error("Edits of " + unit->unit_path + " overlap or run past its end.");
+        }
+
+        damage_end = edits[i].offset + edits[i].length;
+        new_length += edits[i].text.size();
+        new_length -= edits[i].length;
+    }
+
+    ptrdiff_t delta = static_cast<ptrdiff_t>(new_length) - static_cast<ptrdiff_t>(old_length);
+    size_t new_damage_end = damage_end + delta;
+
+    char *contents = new char[new_length + 1];
+    char *out = contents;
+    size_t copied = 0;
+
+    for (auto& edit: edits) {
+        out = std::copy(old_contents + copied, old_contents + edit.offset, out);
+        out = std::copy(edit.text.begin(), edit.text.end(), out);
+        copied = edit.offset + edit.length;
+    }
+
+    out = std::copy(old_contents + copied, old_contents + old_length, out);
+    *out = 0;
+
+    // The new unit owns the contents until they are moved to the old one
+    auto fresh_unit = std::make_unique<Unit>(unit->unit_path, contents);
+    fresh_unit->context = &context;
+
+    auto offset_of = [&](const Token& token) {
+        return static_cast<size_t>(token.start - old_contents);
+    };
+
+    // Relex from the start of the line of the first edit, tokens are only kept before a newline.
+    // The lexer is always in the CODE condition right after a NEWLINE token.
+    size_t first = std::lower_bound(tokens.begin(), tokens.end(), damage_begin, [&](const Token& token, size_t offset) {
+        return offset_of(token) + token.length <= offset;
+    }) - tokens.begin();
+
+    while (first > 0 && tokens[first - 1].id != NEWLINE) {
+        first--;
+    }
+
+    std::vector<Token> fresh;
+    fresh.reserve(tokens.size() + (delta > 0 ? delta : 0));
+
+    for (size_t i = 0; i < first; ++i) {
+        fresh.push_back(tokens[i]);
+        fresh.back().start = contents + offset_of(tokens[i]);
+    }
+
+    size_t line_begin = first ? offset_of(tokens[first - 1]) + tokens[first - 1].length : 0;
+    Lexer lexer(contents, new_length, contents + line_begin, first ? tokens[first - 1].line : 1);
+
+    // Until a NEWLINE token past the edits lines up with an old one, from there on the old tokens are the same
+    size_t resync = tokens.size() - 1;
+
+    while (true) {
+        Token token = lexer.nextToken();
+        fresh.push_back(token);
+
+        if (token.id == END) {
+            break;
+        }
+
+        size_t offset = token.start - contents;
+        if (token.id != NEWLINE || offset < new_damage_end) {
+            continue;
+        }
+
+        size_t old_offset = offset - new_damage_end + damage_end;
+        auto old = std::lower_bound(tokens.begin() + first, tokens.end(), old_offset, [&](const Token& token, size_t offset) {
+            return offset_of(token) < offset;
+        });
+
+        if (old != tokens.end() && offset_of(*old) == old_offset && old->id == NEWLINE && old->length == token.length) {
+            resync = old - tokens.begin();
+            break;
+        }
+    }
+
+    // Old token index + shift is the new index, past the resynchronization point
+    ptrdiff_t shift = static_cast<ptrdiff_t>(fresh.size() - 1) - static_cast<ptrdiff_t>(resync);
+    int line_shift = fresh.back().line - tokens[resync].line;
+
+    for (size_t i = resync + 1; i < tokens.size(); ++i) {
+        fresh.push_back(tokens[i]);
+        fresh.back().start = tokens[i].start + delta - old_contents + contents;
+        fresh.back().line += line_shift;
+    }
+
+    // Declarations overlapping the relexed tokens, [damaged_first, damaged_last)
+    auto& spans = unit->spans;
+
+    size_t damaged_first = 0;
+    while (damaged_first < spans.size() && spans[damaged_first].end <= first) {
+        damaged_first++;
+    }
+
+    // Skipped tokens run up to the next declaration, which may be the damaged one
+    while (damaged_first > 0 && unit->decls[damaged_first - 1]->kind == Node::Kind::SyntaxError) {
+        damaged_first--;
+    }
+
+    size_t damaged_last = damaged_first;
+    while (damaged_last < spans.size() && spans[damaged_last].begin <= resync) {
+        damaged_last++;
+    }
+
+    // Parses everything again, the new unit takes over the contents
+    auto full = [&]() {
+        Parser parser(context, fresh.data());
+        parser.err_handler->detach(fresh_unit.get());
+
+        fresh_unit->contents = nullptr;
+        fresh_unit.reset();
+
+        auto parsed = parser.unit(unit->unit_path, contents);
+        if (!parsed) {
+            return false;
+        }
+
+        parser.err_handler->detach(unit.get());
+        unit = std::move(parsed);
+        tokens.swap(fresh);
+        return true;
+    };
+
+    // Uses and imports may have changed
+    if (spans.empty() || first < spans.front().begin) {
+        return full();
+    }
+
+    size_t begin = damaged_first ? spans[damaged_first - 1].end : spans.front().begin;
+    size_t end = damaged_last < spans.size() ? spans[damaged_last].begin + shift : fresh.size() - 1;
+
+    Parser parser(context, fresh.data() + begin);
+    parser.stream = fresh.data();
+    parser.curr_unit = fresh_unit.get();
+
+    Token *accepted = parser.cursor;
+
+    try {
+        while (parser.cursor < fresh.data() + end && (parser.top_level_declaration(fresh_unit.get()) ||
+               parser.accept_rewind(NEWLINE) || parser.accept_rewind(WHITESPACE))) {
+            accepted = parser.cursor;
+        }
+
+        if (accepted < fresh.data() + end) {
+            parser.raise(*accepted, "Unexpected token at the end of input.");
+        }
+    } catch (Recovery&) {
+        // The new contents go away with the scratch unit
+        parser.err_handler->detach(fresh_unit.get());
+        return false;
+    }
+
+    // A new declaration runs into the next one
+    if (accepted != fresh.data() + end) {
+        return full();
+    }
+
+    // The reused declarations move to the new contents and tokens
+    unit->drop(damaged_first, damaged_last);
+
+    for (size_t i = damaged_first; i < spans.size(); ++i) {
+        spans[i].begin += shift;
+        spans[i].end += shift;
+    }
+
+    std::vector<bool> after(spans.empty() ? 1 : std::max_element(spans.begin(), spans.end(), [](const Unit::DeclSpan& a, const Unit::DeclSpan& b) {
+        return a.owner < b.owner;
+    })->owner + 1, false);
+
+    for (size_t i = damaged_first; i < spans.size(); ++i) {
+        after[spans[i].owner] = true;
+    }
+
+    auto move_token = [&](Token& token, bool is_after) {
+        token.start = token.start - old_contents + contents + (is_after ? delta : 0);
+
+        if (is_after) {
+            token.line += line_shift;
+        }
+    };
+
+    auto move_stream = [&](Token *token) {
+        ptrdiff_t i = token - tokens.data();
+        return fresh.data() + i + (i > static_cast<ptrdiff_t>(resync) ? shift : 0);
+    };
+
+    for (size_t kind = 0; kind < node_kind_count; ++kind) {
+        auto& nodes = unit->nodes(static_cast<Node::Kind>(kind));
+        auto& owners = unit->owners(static_cast<Node::Kind>(kind));
+
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            Node *node = nodes[i];
+            bool is_after = after[owners[i]];
+
+            move_token(node->token, is_after);
+
+            if (node->kind == Node::Kind::MatchStmt) {
+                for (auto& c: static_cast<MatchStmt*>(node)->cases) {
+                    move_token(c.token, is_after);
+                }
+            } else if (node->kind == Node::Kind::FuncDecl) {
+                auto fDecl = static_cast<FunctionDeclaration*>(node);
+                if (fDecl->body_pending()) {
+                    fDecl->body_start = move_stream(fDecl->body_start);
+                    fDecl->body_end = move_stream(fDecl->body_end);
+                }
+            }
+        }
+    }
+
+    parser.adopt(unit.get(), *fresh_unit, damaged_first);
+
+    // Recovered errors point into the new contents, older reports into the old ones
+    parser.err_handler->detach(unit.get());
+    parser.err_handler->detach(fresh_unit.get());
+
+    std::swap(unit->contents, fresh_unit->contents);
+    tokens.swap(fresh);
+    return true;
+}
+
 // optional whitespace then semicolon or newline
 inline bool Parser::statement_separator() {
     bool has = false;
@@ -187,7 +746,7 @@ inline VariantDeclaration *Parser::variantDecl() {
         return nullptr;
     }
 
-    auto vDecl = new VariantDeclaration(Token::concat(start, last()), name, fromType, std::move(templates));
+    auto vDecl = make<VariantDeclaration>(Token::concat(start, last()), name, fromType, std::move(templates));
 
     optional_whitespace_newline();
 
@@ -297,7 +856,7 @@ inline AliasDeclaration *Parser::aliasDecl() {
         return nullptr;
     }
 
-    return new AliasDeclaration(Token::concat(start, last()), name, maybeType, std::move(templates));
+    return make<AliasDeclaration>(Token::concat(start, last()), name, maybeType, std::move(templates));
 }
 
 inline StructDeclaration *Parser::structDecl() {
@@ -311,12 +870,15 @@ inline StructDeclaration *Parser::structDecl() {
 
     optional_whitespace();
 
-    auto *decl = new StructDeclaration(Token::concat(start, last()), name);
+    auto *decl = make<StructDeclaration>(Token::concat(start, last()), name);
 
     // Ok, we sure are in a struct declaration.
     // Try for templates
     templateDef(decl->templates);
 
+    optional_whitespace();
+    structAttributes(decl);
+
     optional_whitespace_newline();
 
     if (!accept(CURLY_OPEN)) {
@@ -333,7 +895,7 @@ inline StructDeclaration *Parser::structDecl() {
             continue;
         }
 
-        if (decl->addField(simpleVariableDecl())) {
+        if (decl->addField(field())) {
             if (!statement_separator()) {
                 break;
             }
@@ -351,9 +913,139 @@ inline StructDeclaration *Parser::structDecl() {
     }
 
     return decl;
+}
+
+// An attribute of a layout attribute list, name or name(argument)
+struct Parser::Attribute {
+    Token token;
+    std::string name;
+
+    // -1 without one
+    int64_t argument;
+};
+
+// Largest align(N)
+static const int64_t max_alignment = 1 << 16;
+
+// BRACK_OPEN op_ws Attribute (op_ws COMMA op_ws Attribute)* op_ws BRACK_CLOSE
+// Attribute <- IDENT (op_ws PAREN_OPEN op_ws INT_LITERAL op_ws PAREN_CLOSE)?
+// An attribute is given at most once in a list.
+inline bool Parser::attributes(std::vector<Attribute>& list) {
+    if (!accept_rewind(BRACK_OPEN)) {
+        return false;
+    }
+
+    do {
+        optional_whitespace();
+
+        if (!accept(IDENTIFIER)) {
+            raise(*last(), "Expected attribute name in attribute list.");
+        }
+
+        Attribute attribute { *last(), last()->value(), -1 };
+
+        for (auto& given: list) {
+            if (given.name == attribute.name) {
+                raise(attribute.token, "Attribute " + attribute.name + " is given more than once.");
+            }
+        }
+
+        optional_whitespace();
+
+        if (accept_rewind(PAREN_OPEN)) {
+            optional_whitespace();
+
+            if (!accept(INT_LITERAL)) {
+                raise(*last(), "Expected integer literal as attribute argument.");
+            }
+
+            attribute.argument = IntLiteral(*last(), last()->value()).value;
+
+            optional_whitespace();
+
+            if (!accept(PAREN_CLOSE)) {
+                raise(*last(), "Expected closing parenthesis after attribute argument.");
+            }
+
+            optional_whitespace();
+        }
+
+        list.push_back(attribute);
+    } while (accept_rewind(COMMA));
+
+    if (!accept(BRACK_CLOSE)) {
+        raise(*last(), "Expected closing bracket after attributes.");
+    }
+
+    return true;
+}
+
+// Sets align or packed from an attribute of a struct or a field, false when it is neither
+inline bool Parser::layoutAttribute(const Attribute& attribute, int& align, bool& packed) {
+    if (attribute.name == "packed") {
+        if (attribute.argument != -1) {
+            raise(attribute.token, "Attribute packed takes no argument.");
+        }
 
-    // TODO: add packing control to language syntax
+        packed = true;
+        return true;
+    }
+
+    if (attribute.name == "align") {
+        int64_t alignment = attribute.argument;
+
+        if (alignment <= 0 || alignment > max_alignment || (alignment & (alignment - 1))) {
+            raise(attribute.token, "Attribute align takes a power of two up to " + std::to_string(max_alignment) + ", as in align(64).");
+        }
+
+        align = alignment;
+        return true;
+    }
+
+    return false;
+}
+
+// Layout attributes of a struct, after its templates: Name : struct <T> [reorder, align(64), soa] { ... }
+inline void Parser::structAttributes(StructDeclaration *decl) {
+    std::vector<Attribute> list;
+    attributes(list);
+
+    for (auto& attribute: list) {
+        if (attribute.name == "reorder" && attribute.argument == -1) {
+            decl->reorder = true;
+        } else if (attribute.name == "soa" && attribute.argument == -1) {
+            decl->soa = true;
+        } else if (!layoutAttribute(attribute, decl->align, decl->packed)) {
+            raise(attribute.token, "Unknown struct attribute " + attribute.name + '.');
+        }
+    }
+}
+
+// Layout attributes of a field, before it: [align(64)] count : int64
+inline VariableDeclaration *Parser::field() {
+    std::vector<Attribute> list;
+
+    if (attributes(list)) {
+        optional_whitespace_newline();
+    }
+
+    VariableDeclaration *field = simpleVariableDecl();
+
+    if (!field) {
+        if (!list.empty()) {
+            raise(*cursor, "Expected field after attributes.");
+        }
+
+        return nullptr;
+    }
+
+    for (auto& attribute: list) {
+        if (!layoutAttribute(attribute, field->align, field->packed)) {
+            raise(attribute.token, "Unknown field attribute " + attribute.name + '.');
+        }
+    }
 
+    return field;
 }
 
 inline BaseType *Parser::baseType() {
@@ -365,7 +1057,7 @@ inline BaseType *Parser::baseType() {
 
     Token nameToken = Token::concat(start, last());
 
-    auto _type = new BaseType(nameToken, nameToken.value());
+    auto _type = make<BaseType>(nameToken, nameToken.value());
 
     optional_whitespace();
 
@@ -451,7 +1143,7 @@ inline FunctionType *Parser::functionType() {
         return nullptr;
     }
 
-    return new FunctionType(Token::concat(start, last()), std::move(argTypes), retType);
+    return make<FunctionType>(Token::concat(start, last()), std::move(argTypes), retType);
 }
 
 inline ClosureType *Parser::closureType() {
@@ -470,7 +1162,7 @@ inline ClosureType *Parser::closureType() {
         return nullptr;
     }
 
-    return new ClosureType(Token::concat(start, last()), std::move(argTypes), retType);
+    return make<ClosureType>(Token::concat(start, last()), std::move(argTypes), retType);
 }
 
 inline TupleType *Parser::tupleType() {
@@ -512,7 +1204,7 @@ inline TupleType *Parser::tupleType() {
         return nullptr;
     }
 
-    return new TupleType(Token::concat(start, last()), std::move(types));
+    return make<TupleType>(Token::concat(start, last()), std::move(types));
     // TODO: Add packing
 }
 
@@ -520,6 +1212,11 @@ inline Type *Parser::type() {
     // So, these are the types we can have:
     // Func type, Closure type, array type, pointer type
     // And finally, "just" a type (known as base type)
+    Nesting nesting(this);
+    if (too_deep()) {
+        return nullptr;
+    }
+
     Token *start = cursor;
 
     Type *ret = baseType();
@@ -542,7 +1239,7 @@ inline Type *Parser::type() {
     // Ok, we have some kind of type, check if it's a pointer or array type (or any combination) now.
     while (true) {
         if (accept_rewind(OP_TIMES)) {
-            ret = new PointerType(Token::concat(start, last()), ret);
+            ret = make<PointerType>(Token::concat(start, last()), ret);
         } else if (accept_rewind(BRACK_OPEN)) {
             optional_whitespace();
 
@@ -552,7 +1249,7 @@ inline Type *Parser::type() {
                 return nullptr;
             }
 
-            ret = new ArrayType(Token::concat(start, last()), ret);
+            ret = make<ArrayType>(Token::concat(start, last()), ret);
         } else {
             break;
         }
@@ -593,9 +1290,10 @@ inline VariableDeclaration *Parser::simpleVariableDecl() {
         return nullptr;
     }
 
-    return new VariableDeclaration(Token::concat(start, last()), name, _type);
+    return make<VariableDeclaration>(Token::concat(start, last()), name, _type);
 }
 
+// Tried wherever a name may be followed by templates, `a < b` is a comparison: the types parsed until then are dropped
 inline bool Parser::templateInstance(Node *parent, std::vector<std::unique_ptr<Type>>& templates) {
     Token *start = cursor;
 
@@ -604,13 +1302,22 @@ inline bool Parser::templateInstance(Node *parent, std::vector<std::unique_ptr<T
         return false;
     }
 
+    size_t count = templates.size();
+    auto mark = curr_unit->index_mark();
+
+    auto backtrack = [&]() {
+        templates.resize(count);
+        curr_unit->forget(mark);
+        cursor = start;
+        return false;
+    };
+
     // op_ws Type (op_ws COMMA op_ws Type)*
     optional_whitespace();
 
     auto maybeType = type();
     if (!maybeType) {
-        cursor = start;
-        return false;
+        return backtrack();
     }
 
     maybeType->parent = parent;
@@ -627,8 +1334,7 @@ inline bool Parser::templateInstance(Node *parent, std::vector<std::unique_ptr<T
 
         maybeType = type();
         if (!maybeType) {
-            cursor = start;
-            return false;
+            return backtrack();
         }
 
         maybeType->parent = parent;
@@ -638,8 +1344,7 @@ inline bool Parser::templateInstance(Node *parent, std::vector<std::unique_ptr<T
     optional_whitespace();
 
     if (!accept(OP_GREATER)) {
-        cursor = start;
-        return false;
+        return backtrack();
     }
 
     return true;
@@ -691,6 +1396,11 @@ inline bool Parser::templateDef(std::vector<TemplateDeclaration>& templates) {
         return false;
     }
 
+    // Templates are stored by value, only index them once the list stops growing.
+    for (auto& temp: templates) {
+        curr_unit->index(&temp, owner);
+    }
+
     return true;
 }
 
@@ -716,11 +1426,11 @@ inline NamespaceDeclaration *Parser::namespace_() {
         return nullptr;
     }
 
-    auto *decl = new NamespaceDeclaration(Token::concat(start, last()), Token::concat(nameStart, last()).value());
+    auto *decl = make<NamespaceDeclaration>(Token::concat(start, last()), Token::concat(nameStart, last()).value());
 
     optional_whitespace_newline();
 
-    if (!accept(CURLY_OPEN)) {
+    if (!accept_rewind(CURLY_OPEN)) {
         raise(*cursor, "Namespace declaration should be followed by a declaration block.");
         return nullptr;
     }
@@ -731,7 +1441,7 @@ inline NamespaceDeclaration *Parser::namespace_() {
     while (decl->addDeclaration(declaration()) || accept_rewind(WHITESPACE) || accept_rewind(NEWLINE)) { accepted = cursor; }
     cursor = accepted;
 
-    if (!accept(CURLY_CLOSE)) {
+    if (!accept_rewind(CURLY_CLOSE)) {
         raise(*cursor, "Expected declaration or closing bracket in namespace declaration.");
         return nullptr;
     }
@@ -783,7 +1493,7 @@ inline Use *Parser::use() {
         usePath = last()->value();
     }
 
-    return new Use(Token::concat(start, last()), useLib, usePath);
+    return make<Use>(Token::concat(start, last()), useLib, usePath);
 }
 
 inline Import *Parser::import() {
@@ -797,7 +1507,27 @@ inline Import *Parser::import() {
         return nullptr;
     }
 
-    return new Import(Token::concat(start, last()), last()->value());
+    // The lexer keeps a name list in the path: unit/path/[a, b]
+    std::string path = last()->value();
+    std::vector<std::string> names;
+
+    size_t list = path.find('[');
+    if (list != std::string::npos) {
+        std::string name;
+
+        for (size_t i = list + 1; i < path.size(); ++i) {
+            if (path[i] == ',' || path[i] == ']') {
+                names.push_back(name);
+                name.clear();
+            } else if (!isspace(static_cast<unsigned char>(path[i]))) {
+                name += path[i];
+            }
+        }
+
+        path.erase(path.find_last_not_of(" \t/", list - 1) + 1);
+    }
+
+    return make<Import>(Token::concat(start, last()), path, names);
 }
 
 // Parses a 'name' (namespace'd identifier)
@@ -866,7 +1596,7 @@ inline FunctionDeclaration *Parser::funcDecl() {
         }
 
         // We are actually an extern function!
-        auto fDecl = new FunctionDeclaration(Token::concat(start, last()), funcName, true, false);
+        auto fDecl = make<FunctionDeclaration>(Token::concat(start, last()), funcName, true, false);
         optional_whitespace_newline();
 
         templateDef(fDecl->templates);
@@ -909,7 +1639,7 @@ inline FunctionDeclaration *Parser::funcDecl() {
         return nullptr;
     }
 
-    auto fDecl = new FunctionDeclaration(Token::concat(start, last()), funcName, false, is_inline);
+    auto fDecl = make<FunctionDeclaration>(Token::concat(start, last()), funcName, false, is_inline);
 
     optional_whitespace_newline();
 
@@ -921,6 +1651,10 @@ inline FunctionDeclaration *Parser::funcDecl() {
 
     optional_whitespace_newline();
 
+    if (lazy_bodies && skip_body(fDecl)) {
+        return fDecl;
+    }
+
     auto maybeBody = scope();
     if (!maybeBody) {
         raise(fDecl->token, "Function declaration is missing body");
@@ -934,6 +1668,71 @@ inline FunctionDeclaration *Parser::funcDecl() {
     return fDecl;
 }
 
+// Records the tokens of a function body by brace matching instead of parsing it
+inline bool Parser::skip_body(FunctionDeclaration *fDecl) {
+    if (cursor->id != CURLY_OPEN) {
+        return false;
+    }
+
+    int open = 0;
+
+    for (Token *tok = cursor; tok->id != END; ++tok) {
+        if (tok->id == CURLY_OPEN) {
+            open++;
+        } else if (tok->id == CURLY_CLOSE && --open == 0) {
+            fDecl->body_start = cursor;
+            fDecl->body_end = tok;
+            fDecl->body_unit = curr_unit;
+            fDecl->body_owner = owner;
+
+            cursor = tok + 1;
+            return true;
+        }
+    }
+
+    // Unbalanced braces, let scope() report the error
+    return false;
+}
+
+Scope *Parser::body(FunctionDeclaration *fDecl) {
+    if (!fDecl->body_pending()) {
+        return fDecl->body.get();
+    }
+
+    Parser parser(*fDecl->body_unit->context, fDecl->body_start);
+    parser.curr_unit = fDecl->body_unit;
+    parser.owner = fDecl->body_owner;
+
+    auto mark = fDecl->body_unit->index_mark();
+
+    Scope *maybeBody;
+    try {
+        maybeBody = parser.scope();
+
+        if (maybeBody && parser.last() != fDecl->body_end) {
+            parser.raise(*parser.last(), "Expected end of function body.");
+            maybeBody = nullptr;
+        }
+    } catch (Recovery&) {
+        // Already reported
+        maybeBody = nullptr;
+    } catch (...) {
+        fDecl->body_unit->forget(mark);
+        throw;
+    }
+
+    if (!maybeBody) {
+        fDecl->body_unit->forget(mark);
+        fDecl->body_failed = true;
+        return nullptr;
+    }
+
+    maybeBody->parent = fDecl;
+    fDecl->body = std::unique_ptr<Scope>(maybeBody);
+
+    return maybeBody;
+}
+
 inline void Parser::func_decl_return_type(FunctionDeclaration *fDecl) {
     optional_whitespace();
 
@@ -1005,7 +1804,7 @@ inline VariableDeclaration *Parser::opt_name_arg() {
 
     auto maybeType = type();
     if (maybeType) {
-        return new VariableDeclaration(Token::concat(start, last()), "", maybeType);
+        return make<VariableDeclaration>(Token::concat(start, last()), "", maybeType);
     }
 
     return nullptr;
@@ -1044,54 +1843,164 @@ inline void Parser::arglist_def_opt_names(FunctionDeclaration *parent, std::vect
                 return;
             }
 
-            maybeArg->parent = parent;
-            arglist.emplace_back(maybeArg);
+            maybeArg->parent = parent;
+            arglist.emplace_back(maybeArg);
+        }
+    }
+
+    optional_whitespace_newline();
+    if (!accept(PAREN_CLOSE)) {
+        raise(*last(), "Expected closing parenthesis of function argument list.");
+        cursor = start;
+        return;
+    }
+}
+
+inline Scope *Parser::scope() {
+    // CURLY_OPEN op_ws_nl (Stmt stmt_separator)* op_ws_nl CURLY_CLOSE
+    Nesting nesting(this);
+    if (too_deep()) {
+        return nullptr;
+    }
+
+    if (explicit_stack) {
+        return flatScope();
+    }
+
+    Token *start = cursor;
+
+    if (!accept_rewind(CURLY_OPEN)) {
+        return nullptr;
+    }
+
+    optional_whitespace_newline();
+
+    auto scope = make<Scope>(*start);
+
+    while (true) {
+        if (!scope->addStmt(scope_statement())) {
+            break;
+        }
+
+        if (!statement_separator()) {
+            break;
+        }
+    }
+
+    optional_whitespace_newline();
+
+    if (!accept(CURLY_CLOSE)) {
+        raise(*last(), "Expected statement or closing curly brace in scope.");
+        cursor = start;
+        return nullptr;
+    }
+
+    return scope;
+}
+
+// Same as scope(), but nested bare scopes are kept on a heap stack instead of recursing through statement()
+Scope *Parser::flatScope() {
+    Token *start = cursor;
+
+    if (!accept_rewind(CURLY_OPEN)) {
+        return nullptr;
+    }
+
+    std::vector<Scope*> open;
+    open.push_back(make<Scope>(*start));
+
+    optional_whitespace_newline();
+
+    while (true) {
+        // A statement starting with a curly brace can only be a scope
+        if (cursor->id == CURLY_OPEN) {
+            open.push_back(make<Scope>(*cursor));
+            cursor++;
+
+            optional_whitespace_newline();
+            continue;
+        }
+
+        if (open.back()->addStmt(scope_statement()) && statement_separator()) {
+            continue;
+        }
+
+        // Close scopes until one of them is followed by a statement separator
+        while (true) {
+            optional_whitespace_newline();
+
+            if (!accept(CURLY_CLOSE)) {
+                raise(*last(), "Expected statement or closing curly brace in scope.");
+                cursor = start;
+                return nullptr;
+            }
+
+            Scope *done = open.back();
+            open.pop_back();
+
+            if (open.empty()) {
+                return done;
+            }
+
+            open.back()->addStmt(done);
+
+            if (statement_separator()) {
+                break;
+            }
         }
     }
-
-    optional_whitespace_newline();
-    if (!accept(PAREN_CLOSE)) {
-        raise(*last(), "Expected closing parenthesis of function argument list.");
-        cursor = start;
-        return;
-    }
 }
 
-inline Scope *Parser::scope() {
-    // CURLY_OPEN op_ws_nl (Stmt stmt_separator)* op_ws_nl CURLY_CLOSE
-    Token *start = cursor;
-
-    if (!accept_rewind(CURLY_OPEN)) {
-        return nullptr;
+// A statement in a scope, nullptr at the end of it.
+// In recover mode, a statement that fails to parse is skipped and replaced by a SyntaxError.
+inline Statement *Parser::scope_statement() {
+    if (!recover) {
+        return statement();
     }
 
-    optional_whitespace_newline();
+    Token *start = cursor;
+    auto mark = curr_unit->index_mark();
 
-    auto scope = new Scope(*start);
+    try {
+        Statement *stmt = statement();
 
-    while (true) {
-        if (!scope->addStmt(statement())) {
-            break;
+        if (stmt || scope_end()) {
+            return stmt;
         }
 
-        if (!statement_separator()) {
-            break;
+        raise(*cursor, "Expected statement or closing curly brace in scope.");
+    } catch (Recovery& recovery) {
+        if (err_handler->saturated()) {
+            throw;
         }
-    }
 
-    optional_whitespace_newline();
+        curr_unit->forget(mark);
 
-    if (!accept(CURLY_CLOSE)) {
-        raise(*last(), "Expected statement or closing curly brace in scope.");
         cursor = start;
-        return nullptr;
+        skip_statement();
+        return syntax_error(start, recovery.message);
     }
 
-    return scope;
+    return nullptr;
+}
+
+// Whether only whitespace is left before a closing curly brace (or the end of the input)
+inline bool Parser::scope_end() {
+    Token *tok = cursor;
+    while (tok->id == WHITESPACE || tok->id == NEWLINE) {
+        tok++;
+    }
+
+    return tok->id == CURLY_CLOSE || tok->id == END;
 }
 
 // TODO: Statements
 inline Statement *Parser::statement() {
+    Nesting nesting(this);
+    if (too_deep()) {
+        return nullptr;
+    }
+
     Statement *ret;
 
     if ((ret = matchStmt())) {
@@ -1141,7 +2050,7 @@ inline Statement *Parser::deferStmt() {
         return nullptr;
     }
 
-    return new DeferStmt(Token::concat(start, last()), maybeScope);
+    return make<DeferStmt>(Token::concat(start, last()), maybeScope);
 }
 
 inline Statement *Parser::matchStmt() {
@@ -1216,7 +2125,7 @@ inline Statement *Parser::matchStmt() {
         return nullptr;
     }
 
-    return new MatchStmt(Token::concat(start, last()), maybeExpr, std::move(cases), elseScope);
+    return make<MatchStmt>(Token::concat(start, last()), maybeExpr, std::move(cases), elseScope);
 }
 
 inline bool Parser::match_case(std::vector<Case>& cases) {
@@ -1336,20 +2245,20 @@ inline Statement *Parser::controlStmt() {
         // Maybe we have a label?
         optional_whitespace();
         if (accept(IDENTIFIER)) {
-            return new BreakStmt(Token::concat(start - 1, last()), last()->value());
+            return make<BreakStmt>(Token::concat(start - 1, last()), last()->value());
         }
         cursor = start;
-        return new BreakStmt(Token::concat(start - 1, last()));
+        return make<BreakStmt>(Token::concat(start - 1, last()));
     } else if (accept_rewind(CONTINUE)) {
         Token *start = cursor;
 
         // Maybe we have a label?
         optional_whitespace();
         if (accept(IDENTIFIER)) {
-            return new ContinueStmt(Token::concat(start - 1, last()), last()->value());
+            return make<ContinueStmt>(Token::concat(start - 1, last()), last()->value());
         }
         cursor = start;
-        return new ContinueStmt(Token::concat(start - 1, last()));
+        return make<ContinueStmt>(Token::concat(start - 1, last()));
     } else {
         return nullptr;
     }
@@ -1384,7 +2293,7 @@ inline Statement *Parser::usingStmt() {
         cursor = afterUsing;
     }
 
-    return new UsingStmt(Token::concat(start, last()), usingName, maybeScope);
+    return make<UsingStmt>(Token::concat(start, last()), usingName, maybeScope);
 }
 
 inline Statement *Parser::returnStmt() {
@@ -1396,7 +2305,7 @@ inline Statement *Parser::returnStmt() {
     optional_whitespace_newline();
 
     auto expr = expression();
-    return new ReturnStmt(Token::concat(start, last()), expr);
+    return make<ReturnStmt>(Token::concat(start, last()), expr);
 }
 
 inline Statement *Parser::forInit() {
@@ -1449,7 +2358,7 @@ inline ForStmt *Parser::forStmt() {
 
     optional_whitespace_newline();
 
-    auto initScope = new Scope(*last());
+    auto initScope = make<Scope>(*last());
 
     Token *beforeInit = cursor;
 
@@ -1521,7 +2430,7 @@ inline ForStmt *Parser::forStmt() {
         return nullptr;
     }
 
-    return new ForStmt(Token::concat(start, last()), label, initScope, condition, loopExpr, body);
+    return make<ForStmt>(Token::concat(start, last()), label, initScope, condition, loopExpr, body);
 }
 
 inline WhileStmt *Parser::whileStmt() {
@@ -1584,7 +2493,7 @@ inline WhileStmt *Parser::whileStmt() {
         return nullptr;
     }
 
-    return new WhileStmt(Token::concat(start, last()), label, maybeExpr, maybeStmt);
+    return make<WhileStmt>(Token::concat(start, last()), label, maybeExpr, maybeStmt);
 }
 
 inline IfStmt *Parser::ifStmt() {
@@ -1640,12 +2549,12 @@ inline IfStmt *Parser::ifStmt() {
             return nullptr;
         }
 
-        return new IfStmt(Token::concat(start, last()), maybeExpr, ifStmt, elseStmt);
+        return make<IfStmt>(Token::concat(start, last()), maybeExpr, ifStmt, elseStmt);
     }
 
     cursor = afterIf;
 
-    return new IfStmt(Token::concat(start, last()), maybeExpr, ifStmt);
+    return make<IfStmt>(Token::concat(start, last()), maybeExpr, ifStmt);
 }
 
 inline void Parser::variable_decl_modifiers(bool& extern_mod, bool& static_mod) {
@@ -1704,7 +2613,7 @@ inline VariableDeclaration *Parser::variableDecl() {
             return nullptr;
         }
 
-        auto decl = new VariableDeclaration(Token::concat(start, last()), name, maybeType);
+        auto decl = make<VariableDeclaration>(Token::concat(start, last()), name, maybeType);
         decl->extern_mod = extern_mod;
         decl->static_mod = static_mod;
 
@@ -1757,7 +2666,7 @@ inline VariableDeclaration *Parser::variableDecl() {
         return nullptr;
     }
 
-    auto decl = new VariableDeclaration(Token::concat(start, last()), name, maybeExpr);
+    auto decl = make<VariableDeclaration>(Token::concat(start, last()), name, maybeExpr);
     decl->static_mod = static_mod;
 
     return decl;
@@ -1766,6 +2675,15 @@ inline VariableDeclaration *Parser::variableDecl() {
 // Expressions bellow, tread with caution
 
 inline Expression *Parser::expression() {
+    Nesting nesting(this);
+    if (too_deep()) {
+        return nullptr;
+    }
+
+    if (explicit_stack) {
+        return flatExpression();
+    }
+
     return assignment();
 }
 
@@ -1795,7 +2713,7 @@ inline Expression *Parser::assignment() {
             return nullptr;
         } 
 
-        return new Assignment(Token::concat(start, last()), left, right, opid);
+        return make<Assignment>(Token::concat(start, last()), left, right, opid);
     } else {
         cursor = afterLeft;
         return left;
@@ -1846,7 +2764,7 @@ inline Expression *Parser::ifExpr() {
                 return nullptr;
             }
 
-            ifScope = new Scope(maybeExpr->token);
+            ifScope = make<Scope>(maybeExpr->token);
             ifScope->addStmt(maybeExpr);
         }
 
@@ -1874,11 +2792,11 @@ inline Expression *Parser::ifExpr() {
                 return nullptr;
             }
 
-            elseScope = new Scope(maybeExpr->token);
+            elseScope = make<Scope>(maybeExpr->token);
             elseScope->addStmt(maybeExpr);
         }
 
-        return new IfExpr(Token::concat(start, last()), condition, ifScope, elseScope);
+        return make<IfExpr>(Token::concat(start, last()), condition, ifScope, elseScope);
     }
 
     // Not an if expression, pass on!
@@ -1911,7 +2829,7 @@ inline Expression *Parser::logicalOr() {
                 return nullptr;
             }
 
-            curr = new BinaryOperator(Token::concat(start, last()), curr, maybeLAnd, opid);
+            curr = make<BinaryOperator>(Token::concat(start, last()), curr, maybeLAnd, opid);
         } else {
             cursor = after;
             break;
@@ -1947,7 +2865,7 @@ inline Expression *Parser::logicalAnd() {
                 return nullptr;
             }
 
-            curr = new BinaryOperator(Token::concat(start, last()), curr, maybeBOr, opid);
+            curr = make<BinaryOperator>(Token::concat(start, last()), curr, maybeBOr, opid);
         } else {
             cursor = after;
             break;
@@ -1983,7 +2901,7 @@ inline Expression *Parser::bitOr() {
                 return nullptr;
             }
 
-            curr = new BinaryOperator(Token::concat(start, last()), curr, maybeBXor, opid);
+            curr = make<BinaryOperator>(Token::concat(start, last()), curr, maybeBXor, opid);
         } else {
             cursor = after;
             break;
@@ -2019,7 +2937,7 @@ inline Expression *Parser::bitXor() {
                 return nullptr;
             }
 
-            curr = new BinaryOperator(Token::concat(start, last()), curr, maybeBAnd, opid);
+            curr = make<BinaryOperator>(Token::concat(start, last()), curr, maybeBAnd, opid);
         } else {
             cursor = after;
             break;
@@ -2055,7 +2973,7 @@ inline Expression *Parser::bitAnd() {
                 return nullptr;
             }
 
-            curr = new BinaryOperator(Token::concat(start, last()), curr, maybeEq, opid);
+            curr = make<BinaryOperator>(Token::concat(start, last()), curr, maybeEq, opid);
         } else {
             cursor = after;
             break;
@@ -2091,7 +3009,7 @@ inline Expression *Parser::equality() {
                 return nullptr;
             }
 
-            curr = new BinaryOperator(Token::concat(start, last()), curr, maybeRel, opid);
+            curr = make<BinaryOperator>(Token::concat(start, last()), curr, maybeRel, opid);
         } else {
             cursor = after;
             break;
@@ -2127,7 +3045,7 @@ inline Expression *Parser::relational() {
                 return nullptr;
             }
 
-            curr = new BinaryOperator(Token::concat(start, last()), curr, maybeShift, opid);
+            curr = make<BinaryOperator>(Token::concat(start, last()), curr, maybeShift, opid);
         } else {
             cursor = after;
             break;
@@ -2164,7 +3082,7 @@ inline Expression *Parser::shift() {
                 return nullptr;
             }
 
-            curr = new BinaryOperator(Token::concat(start, last()), curr, maybeAdd, opid);
+            curr = make<BinaryOperator>(Token::concat(start, last()), curr, maybeAdd, opid);
         } else {
             cursor = after;
             break;
@@ -2200,7 +3118,7 @@ inline Expression *Parser::additive() {
                 return nullptr;
             }
 
-            curr = new BinaryOperator(Token::concat(start, last()), curr, maybeMult, opid);
+            curr = make<BinaryOperator>(Token::concat(start, last()), curr, maybeMult, opid);
         } else {
             cursor = after;
             break;
@@ -2236,7 +3154,7 @@ inline Expression *Parser::multiplicative() {
                 return nullptr;
             }
 
-            curr = new BinaryOperator(Token::concat(start, last()), curr, maybeCast, opid);
+            curr = make<BinaryOperator>(Token::concat(start, last()), curr, maybeCast, opid);
         } else {
             cursor = after;
             break;
@@ -2246,6 +3164,413 @@ inline Expression *Parser::multiplicative() {
     return curr;
 }
 
+// Precedence of the binary operators from logicalOr() to multiplicative(), 0 if id is not one
+int Parser::binary_precedence(int id) {
+    if (id == OP_LOG_OR) {
+        return 1;
+    } else if (id == OP_LOG_AND) {
+        return 2;
+    } else if (id == OP_BIT_OR) {
+        return 3;
+    } else if (id == OP_BIT_XOR) {
+        return 4;
+    } else if (id == OP_BIT_AND) {
+        return 5;
+    } else if (id == OP_EQ || id == OP_NEQ) {
+        return 6;
+    } else if (id == OP_LESS || id == OP_GREATER || id == OP_LESS_EQ || id == OP_GREATER_EQ) {
+        return 7;
+    } else if (id == OP_LOGICAL_SHIFT_RIGHT || id == OP_LOGICAL_SHIFT_LEFT || id == OP_ARITHM_SHIFT_RIGHT || id == OP_ARITHM_SHIFT_LEFT) {
+        return 8;
+    } else if (id == OP_PLUS || id == OP_MINUS) {
+        return 9;
+    } else if (id == OP_TIMES || id == OP_DIV || id == OP_MOD) {
+        return 10;
+    }
+
+    return 0;
+}
+
+// Explicit stack version of expression(), used in explicit_stack mode.
+// It accepts the same grammar and builds the same tree (down to the node tokens), but parentheses, array indices and
+// call arguments open a heap allocated frame instead of recursing, and the binary precedence levels are handled by
+// operator precedence instead of one function each.
+// If expressions, sizeof and is rule lists still go through expression(), they are rare enough.
+Expression *Parser::flatExpression() {
+    struct Operand {
+        Expression *expr;
+        Token *start;
+        Token *end;
+    };
+
+    struct BinaryOp {
+        int opid;
+        int precedence;
+    };
+
+    // One per assignment() level: the whole expression, a parenthesized expression, an index or a call argument
+    struct Frame {
+        enum class Kind {
+            Root, Paren, Index, Call
+        };
+
+        Kind kind;
+        Token *start;
+
+        size_t operand_base;
+        size_t op_base;
+
+        Expression *assign_left;
+        int assign_op;
+
+        // The postfix expression this frame is part of, restored once the frame is closed
+        Token *operand_start;
+        Token *prefix_end;
+        Token *postfix_start;
+        Expression *base;
+
+        // Call arguments
+        std::vector<Argument> args;
+        std::string arg_name;
+        Token *arg_start;
+    };
+
+    enum class State {
+        LevelStart, Operand, Postfix, Prefix, Cast, AfterOperand, Assign, LevelDone
+    };
+
+    Token *start = cursor;
+
+    std::vector<Frame> frames;
+    std::vector<Operand> operands;
+    std::vector<BinaryOp> ops;
+
+    // The postfix expression being built
+    Expression *curr = nullptr;
+    Token *operand_start = cursor;
+    Token *prefix_end = cursor;
+    Token *postfix_start = cursor;
+
+    auto open = [&](Frame::Kind kind, Expression *base) {
+        Frame frame;
+        frame.kind = kind;
+        frame.start = cursor;
+        frame.operand_base = operands.size();
+        frame.op_base = ops.size();
+        frame.assign_left = nullptr;
+        frame.assign_op = 0;
+        frame.operand_start = operand_start;
+        frame.prefix_end = prefix_end;
+        frame.postfix_start = postfix_start;
+        frame.base = base;
+        frame.arg_start = cursor;
+        frames.push_back(std::move(frame));
+    };
+
+    // Named call argument: IDENTIFIER COLON man_ws_nl
+    auto argument_name = [&]() {
+        Frame& frame = frames.back();
+        frame.arg_start = cursor;
+
+        if (accept(IDENTIFIER) && accept(COLON) && mandatory_whitespace_newline()) {
+            frame.arg_name = frame.arg_start->value();
+        } else {
+            cursor = frame.arg_start;
+            frame.arg_name.clear();
+        }
+
+        frame.start = cursor;
+    };
+
+    auto reduce = [&](size_t op_base, int precedence) {
+        while (ops.size() > op_base && ops.back().precedence >= precedence) {
+            Operand right = operands.back();
+            operands.pop_back();
+            Operand left = operands.back();
+            operands.pop_back();
+
+            auto op = make<BinaryOperator>(Token::concat(left.start, right.end), left.expr, right.expr, ops.back().opid);
+            ops.pop_back();
+
+            operands.push_back({ op, left.start, right.end });
+        }
+    };
+
+    open(Frame::Kind::Root, nullptr);
+    State state = State::LevelStart;
+
+    while (true) {
+        switch (state) {
+        case State::LevelStart:
+            // IfExpr can only start an assignment() level
+            if (cursor->id == IF) {
+                curr = ifExpr();
+                if (!curr) {
+                    cursor = start;
+                    return nullptr;
+                }
+
+                // Not followed by binary operators, it may still be the left hand side of an assignment
+                operands.push_back({ curr, frames.back().start, last() });
+                state = State::Assign;
+                break;
+            }
+
+            state = State::Operand;
+            break;
+
+        case State::Operand: {
+            operand_start = cursor;
+
+            while (cursor->id == OP_PLUS || cursor->id == OP_MINUS || cursor->id == OP_BANG || cursor->id == OP_BIT_NOT || cursor->id == OP_TIMES ||
+                   cursor->id == OP_BIT_AND) {
+                cursor++;
+            }
+
+            prefix_end = cursor;
+            postfix_start = cursor;
+
+            if (accept_rewind(PAREN_OPEN)) {
+                open(Frame::Kind::Paren, nullptr);
+                state = State::LevelStart;
+                break;
+            }
+
+            curr = atom();
+            if (curr) {
+                state = State::Postfix;
+                break;
+            }
+
+            if (accept_rewind(SIZEOF)) {
+                curr = sizeof_rest(operand_start);
+                if (!curr) {
+                    cursor = start;
+                    return nullptr;
+                }
+
+                state = State::Prefix;
+                break;
+            }
+
+            // No operand here
+            cursor = operand_start;
+            Frame& frame = frames.back();
+
+            if (ops.size() > frame.op_base) {
+                raise(*last(), "Expected right hand side of operator.");
+            } else if (frame.assign_left) {
+                raise(*last(), "Expected right hand side of assignment.");
+            } else if (frame.kind == Frame::Kind::Root) {
+                cursor = start;
+                return nullptr;
+            } else if (frame.kind == Frame::Kind::Paren) {
+                raise(*last(), "Expected expression between parenthesis.");
+            } else if (frame.kind == Frame::Kind::Index) {
+                raise(*last(), "Expected index in array indexing expression.");
+            } else {
+                // Missing call arguments just end the argument list
+                cursor = frame.arg_start;
+                state = State::LevelDone;
+                break;
+            }
+
+            cursor = start;
+            return nullptr;
+        }
+
+        case State::Postfix: {
+            Token *after = cursor;
+
+            optional_whitespace();
+
+            if (accept_rewind(BRACK_OPEN)) {
+                open(Frame::Kind::Index, curr);
+                optional_whitespace_newline();
+                frames.back().start = cursor;
+
+                state = State::LevelStart;
+                break;
+            }
+
+            optional_whitespace_newline();
+            if (accept(PAREN_OPEN)) {
+                open(Frame::Kind::Call, curr);
+                optional_whitespace_newline();
+                argument_name();
+
+                state = State::LevelStart;
+                break;
+            }
+
+            cursor = after;
+            if (accept_rewind(DOT)) {
+                if (!accept(IDENTIFIER)) {
+                    raise(*last(), "Expected identifier after dot for a field access.");
+                    cursor = start;
+                    return nullptr;
+                }
+
+                curr = make<FieldAccess>(Token::concat(postfix_start, last()), curr, last()->value());
+                break;
+            }
+
+            cursor = after;
+            state = State::Prefix;
+            break;
+        }
+
+        case State::Prefix:
+            for (Token *op = prefix_end - 1; op >= operand_start; --op) {
+                curr = make<UnaryOperator>(Token::concat(operand_start, op), curr, op->id);
+            }
+
+            state = State::Cast;
+            break;
+
+        case State::Cast:
+            curr = cast_ops(curr, operand_start);
+            if (!curr) {
+                cursor = start;
+                return nullptr;
+            }
+
+            operands.push_back({ curr, operand_start, last() });
+            state = State::AfterOperand;
+            break;
+
+        case State::AfterOperand: {
+            Token *after = cursor;
+
+            optional_whitespace_newline();
+
+            int precedence = binary_precedence(cursor->id);
+            if (precedence) {
+                int opid = cursor->id;
+                cursor++;
+
+                reduce(frames.back().op_base, precedence);
+                ops.push_back({ opid, precedence });
+
+                optional_whitespace_newline();
+                state = State::Operand;
+                break;
+            }
+
+            cursor = after;
+            reduce(frames.back().op_base, 0);
+
+            state = State::Assign;
+            break;
+        }
+
+        case State::Assign: {
+            Token *after = cursor;
+
+            Frame& frame = frames.back();
+            if (!frame.assign_left) {
+                // Assignment = IfExpr op_ws_nl AssignmentOperator op_ws_nl IfExpr
+                optional_whitespace_newline();
+
+                if (accept_rewind(OP_ASS) || accept_rewind(OP_PLUS_EQ) || accept_rewind(OP_MINUS_EQ) || accept_rewind(OP_TIMES_EQ) ||
+                    accept_rewind(OP_DIV_EQ) || accept_rewind(OP_MOD_EQ) || accept_rewind(OP_BIT_AND_EQ) || accept_rewind(OP_BIT_XOR_EQ) ||
+                    accept_rewind(OP_BIT_OR_EQ)) {
+
+                    frame.assign_op = last()->id;
+                    frame.assign_left = operands.back().expr;
+                    operands.pop_back();
+
+                    optional_whitespace_newline();
+                    state = State::LevelStart;
+                    break;
+                }
+
+                cursor = after;
+            }
+
+            state = State::LevelDone;
+            break;
+        }
+
+        case State::LevelDone: {
+            Frame& frame = frames.back();
+
+            // Missing call arguments leave no operand behind
+            Expression *value = nullptr;
+            if (operands.size() > frame.operand_base) {
+                value = operands.back().expr;
+                operands.pop_back();
+            }
+
+            if (frame.assign_left) {
+                value = make<Assignment>(Token::concat(frame.start, last()), frame.assign_left, value, frame.assign_op);
+                frame.assign_left = nullptr;
+            }
+
+            if (frame.kind == Frame::Kind::Root) {
+                return value;
+            }
+
+            if (frame.kind == Frame::Kind::Call) {
+                if (value) {
+                    if (frame.arg_name.empty()) {
+                        frame.args.emplace_back(value);
+                    } else {
+                        frame.args.emplace_back(frame.arg_name, value);
+                    }
+
+                    optional_whitespace_newline();
+
+                    if (accept_rewind(COMMA)) {
+                        optional_whitespace_newline();
+                        argument_name();
+
+                        state = State::LevelStart;
+                        break;
+                    }
+                }
+
+                optional_whitespace_newline();
+
+                if (!accept(PAREN_CLOSE)) {
+                    raise(*last(), "Expected closing parenthesis after argument list of function call.");
+                    cursor = start;
+                    return nullptr;
+                }
+            } else if (frame.kind == Frame::Kind::Index) {
+                optional_whitespace_newline();
+
+                if (!accept(BRACK_CLOSE)) {
+                    raise(*last(), "Expected closing bracker in array indexing expression.");
+                    cursor = start;
+                    return nullptr;
+                }
+            } else if (!accept_rewind(PAREN_CLOSE)) {
+                raise(*last(), "Expected closing parenthesis or expression.");
+                cursor = start;
+                return nullptr;
+            }
+
+            operand_start = frame.operand_start;
+            prefix_end = frame.prefix_end;
+            postfix_start = frame.postfix_start;
+
+            if (frame.kind == Frame::Kind::Call) {
+                curr = make<FunctionCall>(Token::concat(postfix_start, last()), frame.base, std::move(frame.args));
+            } else if (frame.kind == Frame::Kind::Index) {
+                curr = make<ArrayIndexing>(Token::concat(postfix_start, last()), frame.base, value);
+            } else {
+                curr = value;
+            }
+
+            frames.pop_back();
+            state = State::Postfix;
+            break;
+        }
+        }
+    }
+}
+
 inline Expression *Parser::cast() {
     Token *start = cursor;
     // Cast = Prefix | Cast man_ws AS man_ws Type | IsExpr
@@ -2256,6 +3581,11 @@ inline Expression *Parser::cast() {
         return nullptr;
     }
 
+    return cast_ops(curr, start);
+}
+
+// The (AS Type | IS ...)* tail of a cast, start is where the prefix expression began
+Expression *Parser::cast_ops(Expression *curr, Token *start) {
     // It is in fact legal to make a chain of casts, though I don't see why you would do it.
     while (true) {
         Token *after = cursor;
@@ -2273,7 +3603,7 @@ inline Expression *Parser::cast() {
                 return nullptr;
             }
 
-            curr = new Cast(Token::concat(start, last()), curr, maybeType);
+            curr = make<Cast>(Token::concat(start, last()), curr, maybeType);
             continue;
         }
 
@@ -2340,7 +3670,7 @@ inline Expression *Parser::cast() {
                 }
             }
 
-            curr = new IsExpr(Token::concat(start, last()), curr, isTag, std::move(isExprs));
+            curr = make<IsExpr>(Token::concat(start, last()), curr, isTag, std::move(isExprs));
         } else {
             cursor = after;
             break;
@@ -2377,33 +3707,8 @@ inline Expression *Parser::prefix() {
             return nullptr;
         }
 
-        optional_whitespace_newline();
-        if (!accept(PAREN_OPEN)) {
-            raise(*last(), "Expected parenthesis after sizeof keyword.");
-            cursor = start;
-            return nullptr;
-        }
-
-        optional_whitespace_newline();
-        auto maybeExpr = expression();
-
-        if (!maybeExpr) {
-            auto maybeType = type();
-            if (!maybeType) {
-                raise(*last(), "Expected expression or type in sizeof parentheses.");
-                cursor = start;
-                return nullptr;
-            }
-
-            curr = new Sizeof(Token::concat(start, last()), maybeType);
-        } else {
-            curr = new Sizeof(Token::concat(start, last()), maybeExpr);
-        }
-
-        optional_whitespace_newline();
-        if (!accept(PAREN_CLOSE)) {
-            raise(*last(), "Expected closing parenthesis after single expression in sizeof operator.");
-            cursor = start;
+        curr = sizeof_rest(start);
+        if (!curr) {
             return nullptr;
         }
     }
@@ -2412,7 +3717,7 @@ inline Expression *Parser::prefix() {
 
     cursor = afterSkip - 1;
     while (cursor >= start) {
-        curr = new UnaryOperator(Token::concat(start, cursor), curr, cursor->id);
+        curr = make<UnaryOperator>(Token::concat(start, cursor), curr, cursor->id);
 
         cursor--;
     }
@@ -2421,6 +3726,43 @@ inline Expression *Parser::prefix() {
     return curr;
 }
 
+// Parses the parenthesized part of sizeof, the SIZEOF token has already been accepted
+Expression *Parser::sizeof_rest(Token *start) {
+    Expression *curr;
+
+    optional_whitespace_newline();
+    if (!accept(PAREN_OPEN)) {
+        raise(*last(), "Expected parenthesis after sizeof keyword.");
+        cursor = start;
+        return nullptr;
+    }
+
+    optional_whitespace_newline();
+    auto maybeExpr = expression();
+
+    if (!maybeExpr) {
+        auto maybeType = type();
+        if (!maybeType) {
+            raise(*last(), "Expected expression or type in sizeof parentheses.");
+            cursor = start;
+            return nullptr;
+        }
+
+        curr = make<Sizeof>(Token::concat(start, last()), maybeType);
+    } else {
+        curr = make<Sizeof>(Token::concat(start, last()), maybeExpr);
+    }
+
+    optional_whitespace_newline();
+    if (!accept(PAREN_CLOSE)) {
+        raise(*last(), "Expected closing parenthesis after single expression in sizeof operator.");
+        cursor = start;
+        return nullptr;
+    }
+
+    return curr;
+}
+
 inline Expression *Parser::postfix() {
     // Postfix = Atom | FunctionCall | ArrayIndex | FieldAccess
 
@@ -2433,6 +3775,11 @@ inline Expression *Parser::postfix() {
         return nullptr;
     }
 
+    return postfix_ops(curr, start);
+}
+
+// Array indexings, calls and field accesses following an atom that began at start
+Expression *Parser::postfix_ops(Expression *curr, Token *start) {
     while (true) {
         Token *after = cursor;
 
@@ -2457,7 +3804,7 @@ inline Expression *Parser::postfix() {
                 return nullptr;
             }
 
-            curr = new ArrayIndexing(Token::concat(start, last()), curr, maybeIndex);
+            curr = make<ArrayIndexing>(Token::concat(start, last()), curr, maybeIndex);
             continue;
         }
 
@@ -2469,7 +3816,7 @@ inline Expression *Parser::postfix() {
             optional_whitespace_newline();
             function_call_arg_list(args);
 
-            curr = new FunctionCall(Token::concat(start, last()), curr, std::move(args));
+            curr = make<FunctionCall>(Token::concat(start, last()), curr, std::move(args));
             continue;
         }
 
@@ -2487,7 +3834,7 @@ inline Expression *Parser::postfix() {
             }
 
             std::string fieldName = last()->value();
-            curr = new FieldAccess(Token::concat(start, last()), curr, fieldName);
+            curr = make<FieldAccess>(Token::concat(start, last()), curr, fieldName);
         } else {
             // None of the above!
             cursor = after;
@@ -2593,7 +3940,7 @@ inline Expression *Parser::atom() {
 
 inline FloatLiteral *Parser::floatLiteral() {
     if (accept_rewind(FLOAT_LITERAL)) {
-        return new FloatLiteral(*last(), last()->value());
+        return make<FloatLiteral>(*last(), last()->value());
     }
 
     return nullptr;
@@ -2601,7 +3948,7 @@ inline FloatLiteral *Parser::floatLiteral() {
 
 inline IntLiteral *Parser::intLiteral() {
     if (accept_rewind(INT_LITERAL)) {
-        return new IntLiteral(*last(), last()->value());
+        return make<IntLiteral>(*last(), last()->value());
     }
 
     return nullptr;
@@ -2609,7 +3956,7 @@ inline IntLiteral *Parser::intLiteral() {
 
 inline CharLiteral *Parser::charLiteral() {
     if (accept_rewind(CHARACTER_LITERAL)) {
-        return new CharLiteral(*last(), last()->value());
+        return make<CharLiteral>(*last(), last()->value());
     }
 
     return nullptr;
@@ -2617,7 +3964,7 @@ inline CharLiteral *Parser::charLiteral() {
 
 inline StringLiteral *Parser::stringLiteral() {
     if (accept_rewind(STRING_LITERAL)) {
-        return new StringLiteral(*last(), last()->value());
+        return make<StringLiteral>(*last(), last()->value());
     }
 
     return nullptr;
@@ -2625,7 +3972,7 @@ inline StringLiteral *Parser::stringLiteral() {
 
 inline BoolLiteral *Parser::boolLiteral() {
     if (accept_rewind(BOOL_LITERAL)) {
-        return new BoolLiteral(*last(), last()->value());
+        return make<BoolLiteral>(*last(), last()->value());
     }
 
     return nullptr;
@@ -2633,7 +3980,7 @@ inline BoolLiteral *Parser::boolLiteral() {
 
 inline NullLiteral *Parser::nullLiteral() {
     if (accept_rewind(NULL_LITERAL)) {
-        return new NullLiteral(*last());
+        return make<NullLiteral>(*last());
     }
 
     return nullptr;
@@ -2648,7 +3995,7 @@ inline VariableAccess *Parser::variableAccess() {
     Token nameToken = Token::concat(start, last());
 
     Token *afterName = cursor;
-    auto vAcc = new VariableAccess(nameToken, nameToken.value());
+    auto vAcc = make<VariableAccess>(nameToken, nameToken.value());
 
     optional_whitespace();
     templateInstance(vAcc, vAcc->templates);
@@ -0,0 +1,279 @@
+#include <Server.hpp>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Messages are length prefixed, a length of none ends the reply and is followed by the exit status
+static const uint32_t none = 0xFFFFFFFF;
+
+#ifndef _WIN32
+
+// A peer going away makes send() fail rather than raise SIGPIPE where the flag exists, serve() ignores the signal anyway
+#ifdef MSG_NOSIGNAL
+static const int send_flags = MSG_NOSIGNAL;
+#else
+static const int send_flags = 0;
+#endif
+
+static bool send_all(int fd, const void *data, size_t size) {
+    auto bytes = static_cast<const char*>(data);
+
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, send_flags);
+        if (sent <= 0) {
+            return false;
+        }
+
+        bytes += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+static bool receive_all(int fd, void *data, size_t size) {
+    auto bytes = static_cast<char*>(data);
+
+    while (size > 0) {
+        ssize_t received = recv(fd, bytes, size, 0);
+        if (received <= 0) {
+            return false;
+        }
+
+        bytes += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+static bool send_string(int fd, const std::string& str) {
+    uint32_t length = str.size();
+    return send_all(fd, &length, sizeof(length)) && send_all(fd, str.data(), str.size());
+}
+
+static bool receive_string(int fd, std::string& str) {
+    uint32_t length;
+    if (!receive_all(fd, &length, sizeof(length)) || length == none) {
+        return false;
+    }
+
+    str.resize(length);
+    return receive_all(fd, &str[0], length);
+}
+
+// What the compiler prints, sent to the client a message per flush or full buffer
+class ReplyBuffer : public std::streambuf {
+public:
+    ReplyBuffer (int _fd) : ok(true), fd(_fd) {
+        setp(buffer, buffer + sizeof(buffer));
+    }
+
+    int sync() override {
+        if (pptr() > pbase()) {
+            ok = ok && send_string(fd, std::string(pbase(), pptr()));
+            setp(buffer, buffer + sizeof(buffer));
+        }
+
+        return 0;
+    }
+
+    int_type overflow(int_type c) override {
+        sync();
+
+        if (c != traits_type::eof()) {
+            *pptr() = c;
+            pbump(1);
+        }
+
+        return traits_type::not_eof(c);
+    }
+
+    // False once the client went away, the rest of the reply is dropped
+    bool ok;
+
+private:
+    int fd;
+    char buffer[4096];
+};
+
+static bool address(const std::string& path, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path " << path << " is too long." << std::endl;
+        return false;
+    }
+
+    strcpy(addr.sun_path, path.c_str());
+    return true;
+}
+
+// Reads a request, the working directory first, and compiles it there
+static void answer(int client, const Server::Compile& compile) {
+    uint32_t count;
+    if (!receive_all(client, &count, sizeof(count)) || count == 0) {
+        return;
+    }
+
+    std::string directory;
+    std::vector<std::string> args;
+
+    if (!receive_string(client, directory)) {
+        return;
+    }
+
+    for (uint32_t i = 1; i < count; ++i) {
+        args.emplace_back();
+
+        if (!receive_string(client, args.back())) {
+            return;
+        }
+    }
+
+    ReplyBuffer reply(client);
+    std::ostream out(&reply);
+
+    int status;
+
+    if (chdir(directory.c_str()) != 0) {
+        out << "Could not enter directory " << directory << '.' << std::endl;
+        status = 1;
+    } else {
+        status = compile(args, out);
+    }
+
+    out.flush();
+
+    int32_t code = status;
+    if (reply.ok && send_all(client, &none, sizeof(none))) {
+        send_all(client, &code, sizeof(code));
+    }
+}
+
+int Server::serve(const std::string& path, const Compile& compile) {
+    sockaddr_un addr;
+    if (!address(path, addr)) {
+        return 1;
+    }
+
+    // A server still answering keeps its socket, only one left by a server that is gone is replaced
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool answered = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+
+    if (probe >= 0) {
+        close(probe);
+    }
+
+    if (answered) {
+        std::cerr << "A server already listens on " << path << '.' << std::endl;
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "Could not open a socket." << std::endl;
+        return 1;
+    }
+
+    unlink(path.c_str());
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        std::cerr << "Could not listen on " << path << '.' << std::endl;
+        close(fd);
+        return 1;
+    }
+
+    // Clients going away are seen as failed sends
+    signal(SIGPIPE, SIG_IGN);
+
+    while (true) {
+        int client = accept(fd, nullptr, nullptr);
+
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            break;
+        }
+
+        answer(client, compile);
+        close(client);
+    }
+
+    close(fd);
+    unlink(path.c_str());
+    return 1;
+}
+
+int Server::forward(const std::string& path, const std::vector<std::string>& args) {
+    sockaddr_un addr;
+    if (!address(path, addr)) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    char directory[4096];
+    if (!getcwd(directory, sizeof(directory))) {
+        close(fd);
+        return -1;
+    }
+
+    uint32_t count = args.size() + 1;
+    bool ok = send_all(fd, &count, sizeof(count)) && send_string(fd, directory);
+
+    for (size_t i = 0; ok && i < args.size(); ++i) {
+        ok = send_string(fd, args[i]);
+    }
+
+    // Printed as it comes, the server may take a while to compile everything
+    std::string message;
+    while (ok && receive_string(fd, message)) {
+        std::cout << message << std::flush;
+    }
+
+    int32_t code;
+    ok = ok && receive_all(fd, &code, sizeof(code));
+    close(fd);
+
+    if (!ok) {
+        std::cerr << "The compile server at " << path << " went away." << std::endl;
+        return 1;
+    }
+
+    return code;
+}
+
+#else
+
+int Server::serve(const std::string& path, const Compile& compile) {
+    std::cerr << "The compile server needs Unix sockets." << std::endl;
+    return 1;
+}
+
+int Server::forward(const std::string& path, const std::vector<std::string>& args) {
+    return -1;
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include <ThreadPool.hpp>
+
+// Worker of the pool the current thread belongs to, submits from a task go to its own deque
+static thread_local ThreadPool *current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+ThreadPool::ThreadPool(int _threads) : queued(0), pending(0), next_worker(0), stop(false) {
+    size_t count = _threads > 1 ? _threads : 1;
+
+    for (size_t i = 0; i < count; ++i) {
+        workers.emplace_back(new Worker());
+    }
+
+    for (size_t i = 1; i < count; ++i) {
+        threads.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        stop = true;
+    }
+
+    idle.notify_all();
+
+    for (auto& thread: threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t target = current_pool == this ? current_worker : next_worker++ % workers.size();
+
+    pending++;
+
+    {
+        std::lock_guard<std::mutex> guard(workers[target]->lock);
+        workers[target]->tasks.push_back(std::move(task));
+    }
+
+    {
+        // Taking the lock orders the increment with the sleepers' check
+        std::lock_guard<std::mutex> guard(idle_lock);
+        queued++;
+    }
+
+    idle.notify_one();
+}
+
+bool ThreadPool::take(size_t self, std::function<void()>& task) {
+    for (size_t i = 0; i < workers.size(); ++i) {
+        Worker& worker = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> guard(worker.lock);
+
+        if (worker.tasks.empty()) {
+            continue;
+        }
+
+        if (i == 0) {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        } else {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        }
+
+        queued--;
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::run(std::function<void()>& task) {
+    try {
+        task();
+    } catch (...) {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        if (!exception) {
+            exception = std::current_exception();
+        }
+    }
+
+    task = nullptr;
+
+    if (--pending == 0) {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        idle.notify_all();
+    }
+}
+
+void ThreadPool::work(size_t self) {
+    current_pool = this;
+    current_worker = self;
+
+    std::function<void()> task;
+
+    while (true) {
+        if (take(self, task)) {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(idle_lock);
+        idle.wait(guard, [&]() { return stop || queued > 0; });
+
+        if (stop) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::wait() {
+    ThreadPool *outer_pool = current_pool;
+    size_t outer_worker = current_worker;
+
+    if (current_pool != this) {
+        current_pool = this;
+        current_worker = 0;
+    }
+
+    std::function<void()> task;
+
+    while (pending > 0) {
+        if (take(current_worker, task)) {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(idle_lock);
+        idle.wait(guard, [&]() { return pending == 0 || queued > 0; });
+    }
+
+    current_pool = outer_pool;
+    current_worker = outer_worker;
+
+    std::exception_ptr thrown;
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        std::swap(thrown, exception);
+    }
+
+    if (thrown) {
+        std::rethrow_exception(thrown);
+    }
+}
@@ -0,0 +1,166 @@
+#include <Watcher.hpp>
+#include <Interface.hpp>
+
+#include <chrono>
+#include <cstdio>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Hash of the contents of path, 0 when it can't be read
+static uint64_t contents_hash(const std::string& path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+
+    uint64_t hash = Interface::hash_basis;
+    char buffer[1 << 16];
+    size_t read;
+
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        hash = Interface::hash(hash, buffer, read);
+    }
+
+    fclose(file);
+    return hash;
+}
+
+#ifdef __linux__
+
+Watcher::Watcher() : fd(inotify_init1(IN_CLOEXEC)), stop(false), events(0), pending(false) {
+    if (fd >= 0) {
+        thread = std::thread(&Watcher::run, this);
+    }
+}
+
+Watcher::~Watcher() {
+    stop = true;
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void Watcher::add(const std::string& directory) {
+    std::string path = directory.empty() ? "." : directory;
+
+    // Editors often write a new file and rename it over the unit
+    int watch = inotify_add_watch(fd, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+
+    if (watch >= 0) {
+        std::lock_guard<std::mutex> guard(lock);
+        directories[watch] = directory;
+    }
+}
+
+void Watcher::run() {
+    alignas(inotify_event) char buffer[1 << 16];
+    pollfd poller { fd, POLLIN, 0 };
+
+    while (!stop) {
+        // Woken up now and then to see whether to stop
+        if (poll(&poller, 1, 200) <= 0) {
+            continue;
+        }
+
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        for (char *at = buffer; at < buffer + length; at += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(at)->len) {
+            auto info = reinterpret_cast<inotify_event*>(at);
+            std::string name = info->len ? info->name : "";
+
+            if (name.size() < 4 || name.compare(name.size() - 4, 4, ".sky") != 0) {
+                continue;
+            }
+
+            auto directory = directories.find(info->wd);
+            if (directory == directories.end()) {
+                continue;
+            }
+
+            std::string path = directory->second;
+            if (!path.empty() && path.back() != '/') {
+                path += '/';
+            }
+
+            paths.insert(path + name);
+            events++;
+            pending = true;
+        }
+
+        event.notify_all();
+    }
+}
+
+void Watcher::know(const std::string& unit, uint64_t hash) {
+    if (hash) {
+        hashes[unit] = hash;
+    } else {
+        hashes.erase(unit);
+    }
+}
+
+std::set<std::string> Watcher::wait(int quiet, bool any) {
+    while (true) {
+        std::unique_lock<std::mutex> guard(lock);
+        event.wait(guard, [this]() { return !paths.empty(); });
+
+        // Until a whole quiet period goes by without events
+        uint64_t seen;
+        do {
+            seen = events;
+            event.wait_for(guard, std::chrono::milliseconds(quiet), [this, seen]() { return events != seen; });
+        } while (events != seen);
+
+        std::set<std::string> taken;
+        taken.swap(paths);
+        pending = false;
+        guard.unlock();
+
+        std::set<std::string> changed;
+        for (auto& path: taken) {
+            uint64_t hash = contents_hash(path);
+            auto known = hashes.find(path);
+
+            if (known == hashes.end() || known->second != hash || any) {
+                hashes[path] = hash;
+                changed.insert(path);
+            }
+        }
+
+        if (!changed.empty()) {
+            return changed;
+        }
+    }
+}
+
+#else
+
+Watcher::Watcher() : fd(-1), stop(false), events(0), pending(false) {}
+
+Watcher::~Watcher() {}
+
+void Watcher::add(const std::string& directory) {}
+
+void Watcher::know(const std::string& unit, uint64_t hash) {}
+
+void Watcher::run() {}
+
+std::set<std::string> Watcher::wait(int quiet, bool any) {
+    return {};
+}
+
+#endif
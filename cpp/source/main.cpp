@@ -1,66 +1,476 @@
-#include <Lexer.hpp>
-#include <Token_ids.hpp>
-#include <Parser.hpp>
-
-#include <Options.hpp>
+#include <ModuleLoader.hpp>
+#include <Binder.hpp>
+#include <Cache.hpp>
+#include <CompilationContext.hpp>
+#include <Layout.hpp>
+#include <Server.hpp>
+#include <ThreadPool.hpp>
+#include <Watcher.hpp>
 
 #include <ASTDumper.hpp>
 
+#include <atomic>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
-#include <vector>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
-void dump_token_stream(const std::vector<Token>& stream) {
-    for (auto& tok: stream) {
-        std::cout << tokNames[tok.id] << ' ';
+// Make escapes spaces in target and prerequisite names
+std::string make_path(const std::string& path) {
+    std::string buff;
+
+    for (char c: path) {
+        if (c == ' ') {
+            buff += '\\';
+        }
+
+        buff += c;
     }
+
+    return buff;
 }
 
-int main(int argc, char *argv[]) {
-    if (argc > 1) {
-        FILE *file = fopen(argv[1], "rb");
+// Hash of the options that change what units compile to, fingerprints include it
+uint64_t options_key(const Options& options) {
+    uint64_t key = Interface::hash_basis;
+
+    if (options.reorder_fields) {
+        key = Interface::hash(key, "reorder", 7);
+    }
+
+    return key;
+}
+
+// Key of what a unit compiles to: its contents, what it sees of the units it depends on, through its fingerprint the options,
+// and how it is dumped, which only its own output depends on
+uint64_t output_key(Module *module, const Options& options) {
+    uint64_t key = Interface::hash(module->key, &module->fingerprint, sizeof(module->fingerprint));
+
+    for (const std::string* dump: { &options.dump_format, &options.dump_kinds }) {
+        uint32_t length = dump->size();
+
+        key = Interface::hash(key, &length, sizeof(length));
+        key = Interface::hash(key, dump->data(), dump->size());
+    }
+
+    key = Interface::hash(key, &options.dump_depth, sizeof(options.dump_depth));
+
+    for (auto& dependency: module->outside) {
+        uint32_t length = dependency.path.size();
+
+        key = Interface::hash(key, &length, sizeof(length));
+        key = Interface::hash(key, dependency.path.data(), dependency.path.size());
+        key = Interface::hash(key, &dependency.fingerprint, sizeof(dependency.fingerprint));
+    }
+
+    return key;
+}
+
+// The top-level declarations of a unit, those importers see when it was loaded from an interface
+static std::vector<Declaration*> declarations_of(Module *module) {
+    if (module->interface) {
+        return module->visible;
+    }
+
+    std::vector<Declaration*> decls;
+    for (auto& decl: module->unit->decls) {
+        decls.push_back(decl.get());
+    }
+
+    return decls;
+}
+
+// What --watch keeps from a build to the next
+struct Watched {
+    // Set when units change, the groups not compiled by then are left to the next build
+    const std::atomic<bool> *cancel;
+    std::atomic<bool> cancelled;
+
+    // Fingerprint each root was last compiled with, while its unit does not change
+    std::unordered_map<std::string, uint64_t> built;
+
+    // Units of the last build, with the hash of the contents it read, 0 for those it did not read
+    std::unordered_map<std::string, uint64_t> units;
+};
+
+// Compiles the units options names, printing to out, returns the exit status.
+// Units read from their source are taken from resident and kept there when it is given.
+// A watched build does not compile again the roots that are as they were, and prints nothing once cancelled.
+static int compile(const Options& options, std::ostream& out, ResidentUnits *resident, Watched *watched = nullptr) {
+    if (options.inputs.empty()) {
+        return 0;
+    }
+
+    CompilationContext context(options);
+    Diagnostics& diagnostics = *context.diagnostics;
+
+    if (resident) {
+        context.names = resident->names;
+    }
+
+    int jobs = options.jobs > 0 ? options.jobs : std::thread::hardware_concurrency();
+    ThreadPool pool(jobs);
+
+    std::unique_ptr<Cache> cache;
+    if (!options.cache_dir.empty()) {
+        cache.reset(new Cache(options.cache_dir));
+    }
+
+    DumpOptions dump;
+    if (!dump.read(options.dump_format, options.dump_depth, options.dump_kinds)) {
+        out << "Unknown dump format " << options.dump_format << " or node kind in " << options.dump_kinds << '.' << std::endl;
+        return 1;
+    }
+
+    // The inputs and every unit they use or import, each loaded once
+    ModuleLoader loader(context, pool, cache.get(), resident);
+
+    loader.load(options.inputs);
+
+    auto& modules = loader.modules();
+
+    size_t roots = 0;
+
+    // Results are gathered in module order, whatever thread made them
+    for (Module *module: modules) {
+        if (module->root) {
+            out << module->token_dump;
+            roots++;
+        }
+    }
+
+    loader.merge();
+
+    if (watched) {
+        watched->cancelled = false;
+        watched->units.clear();
+
+        for (Module *module: modules) {
+            uint64_t hash = 0;
+
+            if (!module->interface && module->unit && module->unit->contents && !module->tokens.empty()) {
+                Unit *unit = module->unit.get();
+                hash = Interface::hash(Interface::hash_basis, unit->contents, unit->contents_length(module->tokens));
+            }
+
+            watched->units[module->path] = hash;
+
+            if (module->root && !module->unchanged) {
+                watched->built.erase(module->path);
+            }
+        }
+    }
+
+    if (options.scan_deps) {
+        // A rule per unit, the units it uses and imports as prerequisites
+        for (Module *module: modules) {
+            out << make_path(module->path) << ':';
+
+            for (Module *dependency: module->dependencies) {
+                out << ' ' << make_path(dependency->path);
+            }
+
+            out << '\n';
+        }
+    } else if (!diagnostics.errors()) {
+        // Units are dumped once the ones they depend on are
+        loader.schedule([roots, &options, &dump, &loader, &cache, watched](std::vector<Module*>& group) {
+            if (watched && *watched->cancel) {
+                watched->cancelled = true;
+                return;
+            }
+
+            // Sizes depend on the units a unit uses, the group is laid out once they are, whatever is compiled of it
+            Layout layout(options.reorder_fields);
+            for (Module *module: group) {
+                if (!module->unit) {
+                    continue;
+                }
+
+                std::vector<Declaration*> decls = declarations_of(module);
+
+                Binder binder(*module->context->names);
+                for (Module *dependency: module->dependencies) {
+                    if (dependency->exports) {
+                        binder.import(dependency->exports.get());
+                    }
+                }
+
+                binder.signatures(decls);
+                layout.add(decls, module->interface ? nullptr : module->unit.get(), module->context->err_handler);
+            }
+
+            layout.lay();
 
-        if (file) {
-            Options::get().read(argc, argv);
+            for (Module *module: group) {
+                if (options.layout_report && module->root && module->unit) {
+                    module->layout_report = layout.report(declarations_of(module), make_path(module->path));
+                }
+            }
 
-            fseek(file, 0, SEEK_END);
+            if (options.emit_interface || cache || watched) {
+                loader.fingerprint(group, options_key(options));
+            }
 
-            int length = ftell(file);
-            fseek(file, 0, SEEK_SET);
+            for (Module *module: group) {
+                // Dependencies read from their source go in the cache for the next importers, unless they reported errors
+                if (!module->root && module->key && !module->interface && !module->context->buffered_errors() && !cache->has(module->key, "skyi")) {
+                    std::string scratch = cache->scratch();
 
-            char *buffer = new char[length + 1];
+                    if (Interface::write(module->unit.get(), module->fingerprint, module->outside, scratch)) {
+                        cache->store(module->key, "skyi", scratch);
+                        std::remove(scratch.c_str());
+                    }
+                }
 
-            fread(buffer, 1, length, file);
-            buffer[length] = 0;
+                if (!module->root) {
+                    continue;
+                }
 
-            fclose(file);
+                // A lone unit keeps the historical output name, the extension is that of the format
+                std::string outpath = (roots == 1 ? std::string("out") : module->path) + dump.extension();
 
-            Lexer lexer(buffer);
-            std::vector<Token> tokens;
+                // Neither it nor what it sees of its dependencies changed, what it was compiled to still holds,
+                // if it was dumped in this format. A lone unit's output name is shared, it is always dumped.
+                if (module->current && roots > 1 && FileStamp::of(outpath).size >= 0) {
+                    continue;
+                }
 
-            Token curr;
-            do {
-                curr = lexer.nextToken();
-                tokens.emplace_back(curr);
-            } while (curr.id != END);
+                if (watched && module->unchanged) {
+                    auto built = watched->built.find(module->path);
 
-            // Version pass here.
-            // Evaluates versions, keeps tokens we want
-            // This means version is context free, you can put it anywhere in your code
-            // (just be careful with it please)
+                    if (built != watched->built.end() && built->second == module->fingerprint) {
+                        continue;
+                    }
+                }
 
-            std::cout << "Token stream (" << tokens.size() << " tokens): " << std::endl;
-            dump_token_stream(tokens);
-            std::cout << std::endl;
+                std::string interface = module->path + 'i';
+                uint64_t key = module->key ? output_key(module, options) : 0;
 
-            Parser parser(&tokens.front());
-            auto u = parser.unit(std::string(argv[1]), buffer);
+                // Compiled before, by this compiler or another. Dumps are kept by their extension.
+                if (key && cache->fetch(key, dump.extension() + 1, outpath) && (!options.emit_interface || cache->fetch(key, "skyi", interface))) {
+                    continue;
+                }
 
-            ASTDumper(&*u, "out.dot");
+                bool reparsed = module->interface != nullptr;
+
+                if (reparsed && !loader.reparse(module)) {
+                    continue;
+                }
+
+                // Bound in every build, a resident unit may still point into units of the previous one
+                Binder binder(*module->context->names);
+                for (Module *dependency: module->dependencies) {
+                    if (dependency->exports) {
+                        binder.import(dependency->exports.get());
+                    }
+                }
+
+                binder.bind(module->unit.get());
+
+                if (reparsed) {
+                    std::vector<Declaration*> decls;
+                    for (auto& decl: module->unit->decls) {
+                        decls.push_back(decl.get());
+                    }
+
+                    layout.add(decls, module->unit.get(), module->context->err_handler);
+                    layout.lay();
+                }
+
+                layout.fold(module->unit.get(), module->context->err_handler);
+                layout.lower(module->unit.get());
+
+                // An output that can't be written is the unit's error, the others go on
+                bool dumped = true;
+                try {
+                    ASTDumper(&*module->unit, outpath, dump);
+                } catch (std::runtime_error& e) {
+                    module->context->err_handler->report(e.what());
+                    dumped = false;
+                }
+
+                // Lazily skipped bodies are parsed by now, and types laid out: a unit with errors in them gets no interface,
+                // which would have the next build take it for compiled
+                bool failed = !dumped || module->context->buffered_errors() > 0;
+
+                bool written = options.emit_interface && !failed && Interface::write(module->unit.get(), module->fingerprint, module->outside, interface);
+
+                if (options.emit_interface && !failed && !written) {
+                    module->context->err_handler->report("Could not write interface " + interface + '.');
+                }
+
+                if (options.emit_interface && failed) {
+                    // Nor keeps the one of its last good build
+                    std::remove(interface.c_str());
+                }
+
+                // Nor is it cached, a fetch would pass over its errors
+                if (key && !failed) {
+                    // The interface of the contents, for importers, and what they compiled to
+                    std::string scratch = written ? interface : cache->scratch();
+
+                    if (written || Interface::write(module->unit.get(), module->fingerprint, module->outside, scratch)) {
+                        cache->store(module->key, "skyi", scratch);
+                        cache->store(key, "skyi", scratch);
+                    }
+
+                    if (!written) {
+                        std::remove(scratch.c_str());
+                    }
+
+                    cache->store(key, dump.extension() + 1, outpath);
+                }
+            }
+        });
+
+        // Lazily skipped bodies are parsed while binding
+        loader.merge();
+
+        for (Module *module: modules) {
+            out << module->layout_report;
         }
+
+        // With the interfaces just written
+        if (!options.bundle.empty() && !diagnostics.errors() && !(watched && watched->cancelled)) {
+            loader.bundle(options.bundle);
+        }
+    }
+
+    if (watched) {
+        // Recorded on this thread, the pass only looked the fingerprints up
+        for (Module *module: modules) {
+            if (!module->root) {
+                continue;
+            }
+
+            if (module->fingerprint && !diagnostics.errors()) {
+                watched->built[module->path] = module->fingerprint;
+            } else {
+                watched->built.erase(module->path);
+            }
+        }
+    }
+
+    // The next build reports what is still wrong
+    if (!watched || !watched->cancelled) {
+        diagnostics.flush(out);
+    }
+
+    // Once flushed: reports may point into the units
+    if (resident) {
+        resident->keep(modules);
+    }
+
+    if (watched && watched->cancelled) {
+        return 1;
+    }
+
+    if (diagnostics.errors()) {
+        out << diagnostics.errors() << " error(s)." << std::endl;
+        return 1;
     }
 
     return 0;
 }
 
+static std::string directory_of(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+// Builds, then builds again each time units of the build change, until interrupted.
+// Parsed units are kept in between, those that did not change are not parsed again.
+static int watch(const Options& options) {
+    Watcher watcher;
+
+    if (!watcher.ok()) {
+        std::cerr << "Watching units needs inotify." << std::endl;
+        return 1;
+    }
+
+    // Changes made while the first build runs are seen too
+    for (auto& input: options.inputs) {
+        watcher.add(directory_of(input));
+    }
+
+    ResidentUnits resident;
+    Watched watched;
+    watched.cancel = &watcher.changed();
+
+    while (true) {
+        compile(options, std::cout, &resident, &watched);
+
+        // What changed since the build read it is seen as a change
+        for (auto& unit: watched.units) {
+            watcher.add(directory_of(unit.first));
+            watcher.know(unit.first, unit.second);
+        }
+
+        std::set<std::string> changed;
+
+        if (watched.cancelled) {
+            // Rebuilt as soon as the edits that cancelled it stop, whatever they were
+            changed = watcher.wait(100, true);
+        } else {
+            std::cout << "Watching " << watched.units.size() << " unit(s)." << std::endl;
+            changed = watcher.wait();
+        }
+
+        std::cout << "Changed:";
+        for (auto& path: changed) {
+            std::cout << ' ' << path;
+        }
+
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    options.read(argc, argv);
+
+    if (options.watch) {
+        return watch(options);
+    }
+
+    if (!options.serve.empty()) {
+        ResidentUnits resident;
+
+        return Server::serve(options.serve, [&resident](std::vector<std::string>& args, std::ostream& out) {
+            std::vector<char*> argv { const_cast<char*>("sky") };
+            for (auto& arg: args) {
+                argv.push_back(&arg[0]);
+            }
+
+            Options request;
+            request.read(argv.size(), argv.data());
+            request.serve.clear();
+            request.server.clear();
+
+            return compile(request, out, &resident);
+        });
+    }
+
+    if (!options.server.empty()) {
+        std::vector<std::string> args;
+        for (int i = 1; i < argc; ++i) {
+            if (strncmp(argv[i], "--server=", 9)) {
+                args.push_back(argv[i]);
+            }
+        }
+
+        // Compiled here when there is no server
+        int status = Server::forward(options.server, args);
+        if (status >= 0) {
+            return status;
+        }
+    }
+
+    return compile(options, std::cout, nullptr);
+}
@@ -0,0 +1,163 @@
+#include <CompilationContext.hpp>
+#include <Exports.hpp>
+#include <Lexer.hpp>
+#include <Parser.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Exports::find on the tables of small units, printing a line per check
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "ok " : "FAIL ") << what << std::endl;
+    failures += !ok;
+}
+
+// A unit parsed from source, with the tokens it points into
+struct Parsed {
+    std::vector<Token> tokens;
+    std::unique_ptr<Unit> unit;
+
+    std::vector<Declaration*> decls() const {
+        std::vector<Declaration*> list;
+        for (auto& decl: unit->decls) {
+            list.push_back(decl.get());
+        }
+
+        return list;
+    }
+};
+
+static void parse(CompilationContext& context, const char *source, Parsed& parsed) {
+    char *contents = new char[strlen(source) + 1];
+    strcpy(contents, source);
+
+    Lexer lexer(contents);
+    Token curr;
+    do {
+        curr = lexer.nextToken();
+        parsed.tokens.emplace_back(curr);
+    } while (curr.id != END);
+
+    Parser parser(context, &parsed.tokens.front());
+    parsed.unit = parser.unit("test.sky", contents);
+}
+
+static const Exports::Entry *find(const Exports& exports, const std::string& name) {
+    return exports.find(name, Exports::name_hash(name));
+}
+
+// Every name the same, no seed tells them apart
+static uint64_t same_hash(const std::string& name) {
+    return 42;
+}
+
+static const char *source =
+    "namespace geo {\n"
+    "    Point : struct {\n"
+    "        x : int32\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "Shape : struct {\n"
+    "    a : int8\n"
+    "}\n"
+    "\n"
+    "namespace geo {\n"
+    "    Line : struct {\n"
+    "        a : geo::Point\n"
+    "    }\n"
+    "\n"
+    "    Point : alias from int64\n"
+    "}\n"
+    "\n"
+    "Shape : alias from int32\n"
+    "\n"
+    "namespace gone {\n"
+    "    Hidden : struct {\n"
+    "        a : int8\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "gone : struct {\n"
+    "    a : int8\n"
+    "}\n";
+
+int main() {
+    Options options;
+    CompilationContext context(options);
+
+    Parsed parsed;
+    parse(context, source, parsed);
+    check(parsed.unit && !context.diagnostics->errors(), "unit parses");
+
+    Exports exports(parsed.decls());
+    check(exports.size() == 3, "one entry per name");
+
+    // A namespace declared again adds to the first
+    const Exports::Entry *geo = find(exports, "geo");
+    check(geo && geo->decl == parsed.unit->decls[0].get(), "namespace declared again is the first declaration");
+    check(geo && geo->members && geo->members->size() == 2, "namespace declared again has the members of both");
+
+    const Exports::Entry *line = geo && geo->members ? find(*geo->members, "Line") : nullptr;
+    check(line && line->decl->kind == Node::Kind::StructDecl, "member of the second declaration is found");
+
+    // A later declaration hides an earlier one, in namespaces too
+    const Exports::Entry *point = geo && geo->members ? find(*geo->members, "Point") : nullptr;
+    check(point && point->decl->kind == Node::Kind::AliasDecl, "later member hides the earlier one");
+
+    const Exports::Entry *shape = find(exports, "Shape");
+    check(shape && shape->decl == parsed.unit->decls[3].get(), "later declaration hides the earlier one");
+
+    const Exports::Entry *gone = find(exports, "gone");
+    check(gone && gone->decl->kind == Node::Kind::StructDecl && !gone->members, "struct hiding a namespace drops its members");
+
+    check(!find(exports, "Point") && !find(exports, "geo::Point") && !find(exports, "Hidden"), "members are not top-level names");
+    check(!find(exports, "missing") && !exports.find("geo", Exports::name_hash("geo") + 1), "unknown name or hash is not found");
+
+    // Keys of the same hash have no perfect hash, the table is then looked through
+    std::vector<uint32_t> seeds, keys;
+    check(!Exports::perfect({ 7, 3, 7 }, seeds, keys), "perfect() fails on equal hashes");
+    check(Exports::perfect({ 7, 3, 9 }, seeds, keys), "perfect() succeeds on distinct hashes");
+
+    Exports colliding(parsed.decls(), same_hash);
+    check(colliding.size() == 3, "equal hashes keep one entry per name");
+
+    const Exports::Entry *same_geo = colliding.find("geo", same_hash("geo"));
+    const Exports::Entry *same_shape = colliding.find("Shape", same_hash("Shape"));
+    check(same_geo && same_geo->decl == geo->decl && same_shape && same_shape->decl == shape->decl, "equal hashes are told apart by name");
+    check(same_geo && same_geo->members && same_geo->members->find("Line", same_hash("Line")), "members made with the same hash");
+    check(!colliding.find("missing", same_hash("missing")), "equal hash of an unknown name is not found");
+
+    // Many names, each found in its one slot
+    std::string many;
+    for (int i = 0; i < 500; ++i) {
+        many += "S" + std::to_string(i) + " : struct {\n    a : int8\n}\n";
+    }
+
+    Parsed large;
+    parse(context, many.c_str(), large);
+
+    Exports large_exports(large.decls());
+    bool all = large_exports.size() == 500;
+    for (int i = 0; all && i < 500; ++i) {
+        const Exports::Entry *entry = find(large_exports, "S" + std::to_string(i));
+        all = entry && entry->decl == large.unit->decls[i].get();
+    }
+
+    check(all, "every name of a large table is found");
+
+    // An empty unit
+    Parsed empty;
+    parse(context, "", empty);
+
+    Exports none(empty.decls());
+    check(empty.unit && none.size() == 0 && !find(none, "geo") && !find(none, ""), "empty unit exports nothing");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+#!/bin/sh
+
+# Golden tests: tests/run.sh [compiler], bin/sky.exe by default.
+# A test is a directory of units with an args file, the arguments of a compiler run per line, and an expected directory.
+# The runs are made in order in a copy of the units, what they print and their exit status going to output,
+# then each file of expected must be found the same in the copy. Line endings are not compared.
+# A line of args starting with $ is run as a shell command instead.
+# A test with a test.cpp is built against the sources of the compiler, $CXX or g++, and run before the args.
+
+sky=${1:-bin/sky.exe}
+
+case $sky in
+    /*) ;;
+    *) sky=$(pwd)/$sky ;;
+esac
+
+tests=$(cd "$(dirname "$0")" && pwd)
+sources=$(ls "$(dirname "$tests")"/source/*.cpp | grep -v '/main\.cpp$')
+failed=0
+
+for test in "$tests"/*/
+do
+    name=$(basename "$test")
+    scratch=$(mktemp -d)
+
+    for file in "$test"*
+    do
+        case $(basename "$file") in
+            args|expected) ;;
+            *) cp "$file" "$scratch" ;;
+        esac
+    done
+
+    if [ -f "$test"test.cpp ]
+    then
+        (
+            cd "$scratch"
+            ${CXX:-g++} -std=c++14 -pthread -I"$(dirname "$tests")"/include test.cpp $sources -o test > output 2>&1 && ./test >> output 2>&1
+            echo "exit $?" >> output
+        )
+    fi
+
+    [ -f "$test"args ] && tr -d '\r' < "$test"args | (
+        cd "$scratch"
+
+        while read -r args
+        do
+            case $args in
+                '$ '*) sh -c "${args#\$ }" >> output 2>&1 ;;
+                *) $sky $args >> output 2>&1 ;;
+            esac
+
+            echo "exit $?" >> output
+        done
+    )
+
+    result=pass
+
+    for expected in "$test"expected/*
+    do
+        file=$(basename "$expected")
+        tr -d '\r' < "$expected" > "$scratch/expected"
+
+        if [ ! -f "$scratch/$file" ] || ! tr -d '\r' < "$scratch/$file" | diff -u "$scratch/expected" - > "$scratch/diff"
+        then
+            echo "$name: $file differs"
+            cat "$scratch/diff" 2> /dev/null
+            result=fail
+        fi
+    done
+
+    rm -rf "$scratch"
+
+    if [ $result = pass ]
+    then
+        echo "$name: ok"
+    else
+        failed=$((failed + 1))
+    fi
+done
+
+if [ $failed -gt 0 ]
+then
+    echo "$failed test(s) failed."
+    exit 1
+fi